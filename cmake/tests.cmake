@@ -23,10 +23,25 @@ add_executable(CITests_decoder
   ${CMAKE_CURRENT_LIST_DIR}/../tests/SimplifiedDecoderAlgorithm.cpp
   ${CMAKE_CURRENT_LIST_DIR}/../tests/DecoderKernel.cpp
   ${CMAKE_CURRENT_LIST_DIR}/../tests/QuantumDecoderAlgorithm.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/BeamCollapse.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/BeamAggregation.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/DirectSampler.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/CtcReference.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/CtcReferenceDecoderAlgorithm.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/LruCache.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/ProbabilityTable.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/ResourcePlan.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/AncillaLiveness.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/Batch.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/BoundedExecutor.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/Streaming.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/SymbolCodebook.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../tests/TimestepPruning.cpp
 )
 target_link_libraries(CITests_decoder
   PRIVATE
     qristal::core
+    decoder_common
     GTest::gtest
     GTest::gtest_main
     GTest::gmock
@@ -0,0 +1,84 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "Accelerator.hpp"
+#include "xacc.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace qristal {
+
+  // Per-thread accelerator pool
+
+  // Accelerators of one backend, one per thread that asks for one: every call from a thread returns the
+  // same instance, created through xacc::getAccelerator on the thread's first call, and no two threads
+  // share an instance. Decoders take their qpu from a pool unless given an accelerator instance, so that
+  // several threads can decode at once, each on its own simulator. A pool may be shared between decoders
+  // (see the accelerator_pool option) and must outlive them.
+  //
+  // Some backends are services that xacc::getAccelerator returns as one shared instance. The pool tells
+  // when a second thread asks for its accelerator, without building any spare one: until then, and if the
+  // instance turns out to be shared, decoders run its circuits one at a time, under exclusive().
+
+  class AcceleratorPool {
+
+    public:
+
+      explicit AcceleratorPool(std::string name, xacc::HeterogeneousMap options = {})
+          : name_(std::move(name)), options_(std::move(options)) {}
+
+      AcceleratorPool(const AcceleratorPool &) = delete;
+      AcceleratorPool &operator=(const AcceleratorPool &) = delete;
+
+      // The calling thread's accelerator
+      xacc::Accelerator *get() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const std::thread::id thread = std::this_thread::get_id();
+        auto &accelerator = accelerators_[thread];
+        if (!accelerator) {
+          accelerator = xacc::getAccelerator(name_, options_);
+          for (const auto &[other_thread, other] : accelerators_) {
+            if (other_thread != thread) {
+              (other == accelerator ? shared_ : distinct_) = true;
+            }
+          }
+        }
+        return accelerator.get();
+      }
+
+      const std::string &name() const { return name_; }
+
+      // Whether two threads were given the same instance, as by a backend with a single, shared one
+      bool shared() const { return shared_; }
+
+      // Held while running circuits on the calling thread's accelerator, after get: locked unless threads
+      // are known to have instances of their own
+      std::unique_lock<std::mutex> exclusive() {
+        return distinct_ && !shared_ ? std::unique_lock<std::mutex>() : std::unique_lock<std::mutex>(run_mutex_);
+      }
+
+      // Number of threads that have used the pool, each with an accelerator of its own unless shared
+      std::size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return accelerators_.size();
+      }
+
+    private:
+
+      std::string name_;
+      xacc::HeterogeneousMap options_;
+      std::atomic<bool> shared_{false};
+      std::atomic<bool> distinct_{false};
+      std::mutex mutex_;
+      std::mutex run_mutex_;
+      std::unordered_map<std::thread::id, std::shared_ptr<xacc::Accelerator>> accelerators_;
+
+  };
+
+}
@@ -0,0 +1,51 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace qristal {
+
+  // Ancilla liveness analysis and qubit reuse
+
+  // Tracks the computational basis value of every qubit through a circuit as a polynomial over GF(2) in
+  // the input values, so an ancilla that is computed and later uncomputed is provably back in |0> even if
+  // it was used as a control in between. Gates that permute basis states (X, CNOT, Swap, ...) and diagonal
+  // gates are tracked exactly. Sub-circuits on at most max_window_qubits qubits are simulated as a whole,
+  // so a decomposed Toffoli or comparator still counts as a permutation even though its gates do not.
+  // Anything else gives the qubits it may change a fresh, unknown value. The analysis only ever fails to
+  // prove a qubit clean; it never proves a qubit clean that is not.
+  //
+  // Every ancilla is then split into live ranges, from a gate that finds it in |0> to the gate that
+  // provably returns it there, and the ranges are packed onto as few pool qubits as possible.
+
+  // A circuit as the analysis sees it: a tree of composites whose leaves are gates
+  struct CircuitNode {
+    std::string name;
+    std::vector<int> qubits;           // gates only
+    std::vector<double> parameters;    // gates only
+    std::vector<CircuitNode> children; // composites only
+    bool composite = false;
+    int id = -1;                       // caller's handle for a gate, returned in RemappedGate
+  };
+
+  struct RemappedGate {
+    int id;
+    std::vector<int> qubits;
+  };
+
+  struct AncillaReuse {
+    std::vector<RemappedGate> gates; // every gate of the circuit in order, ancillas remapped
+    std::vector<int> ancillas_used;  // pool qubits the remapped circuit uses, in pool order
+    std::vector<int> dirty_ancillas; // pool qubits of the remapped circuit not provably |0> at its end
+  };
+
+  constexpr int max_window_qubits = 8;
+
+  // Remap the ancillas of a circuit onto as few qubits of ancilla_pool as liveness allows. Pool qubits
+  // must start in |0>; the reserved ones are also left in |0> at the end, for a following circuit to use.
+  AncillaReuse reuse_ancillas(const CircuitNode &circuit, const std::vector<int> &ancilla_pool,
+                              const std::vector<int> &reserved = {});
+
+}
@@ -0,0 +1,100 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "qristal/decoder/bounded_executor.hpp"
+
+#include "Algorithm.hpp"
+#include "AcceleratorBuffer.hpp"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+
+namespace qristal {
+
+  // Asynchronous decoding
+
+  // Runs execute of decoders (quantum-decoder, simplified-decoder or any other xacc algorithm, each
+  // initialized with its utterance's probability table) on nb_workers threads of its own, so that the
+  // caller can go on with e.g. the acoustic model inference of the next utterance while this one decodes.
+  // At most max_pending decodes are queued or running: execute waits for room, try_execute returns nothing
+  // instead, leaving the caller to hold or drop the utterance. Results come as a future of the buffer, or
+  // through a callback run on the worker thread, with the exception execute threw if any; the callback
+  // must not throw.
+  //
+  // With more than one worker, decoders whose qpu is an accelerator instance rather than from an
+  // accelerator pool (the default, see accelerator_pool.hpp) must not share it. Pending decodes are
+  // finished before the AsyncDecoder is destroyed.
+
+  class AsyncDecoder {
+
+    public:
+
+      using Buffer = std::shared_ptr<xacc::AcceleratorBuffer>;
+      using Callback = std::function<void(Buffer, std::exception_ptr)>;
+      using Decoder = std::shared_ptr<xacc::Algorithm>;
+
+      explicit AsyncDecoder(std::size_t nb_workers = 1, std::size_t max_pending = 2)
+          : executor_(nb_workers, max_pending) {}
+
+      // Run decoder into buffer, first waiting while max_pending decodes are in flight
+      std::future<Buffer> execute(Decoder decoder, Buffer buffer) {
+        auto task = make_task(std::move(decoder), std::move(buffer));
+        std::future<Buffer> result = task->get_future();
+        executor_.submit([task] { (*task)(); });
+        return result;
+      }
+
+      void execute(Decoder decoder, Buffer buffer, Callback callback) {
+        executor_.submit(make_task(std::move(decoder), std::move(buffer), std::move(callback)));
+      }
+
+      // Run decoder into buffer unless max_pending decodes are in flight
+      std::optional<std::future<Buffer>> try_execute(Decoder decoder, Buffer buffer) {
+        auto task = make_task(std::move(decoder), std::move(buffer));
+        std::future<Buffer> result = task->get_future();
+        if (!executor_.try_submit([task] { (*task)(); })) {
+          return std::nullopt;
+        }
+        return result;
+      }
+
+      bool try_execute(Decoder decoder, Buffer buffer, Callback callback) {
+        return executor_.try_submit(make_task(std::move(decoder), std::move(buffer), std::move(callback)));
+      }
+
+      // Wait until every decode submitted has finished
+      void wait() { executor_.wait_idle(); }
+
+      // Decodes queued or running
+      std::size_t pending() { return executor_.pending(); }
+
+    private:
+
+      std::shared_ptr<std::packaged_task<Buffer()>> make_task(Decoder decoder, Buffer buffer) {
+        return std::make_shared<std::packaged_task<Buffer()>>([decoder = std::move(decoder), buffer] {
+          decoder->execute(buffer);
+          return buffer;
+        });
+      }
+
+      std::function<void()> make_task(Decoder decoder, Buffer buffer, Callback callback) {
+        return [decoder = std::move(decoder), buffer, callback = std::move(callback)] {
+          std::exception_ptr error;
+          try {
+            decoder->execute(buffer);
+          } catch (...) {
+            error = std::current_exception();
+          }
+          callback(buffer, error);
+        };
+      }
+
+      BoundedExecutor executor_;
+
+  };
+
+}
@@ -0,0 +1,17 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace qristal {
+
+  // Batch decoding
+
+  // Order in which to decode a batch of probability tables: grouped by shape (timesteps, then symbols),
+  // in input order within a shape, so that consecutive decodes share the circuit templates and caches of
+  // their shape
+  std::vector<std::size_t> batch_order(const std::vector<std::vector<std::vector<float>>> &probability_tables);
+
+}
@@ -0,0 +1,112 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "qristal/decoder/beam_collapse.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace qristal {
+
+  // Beam shot-count table
+
+  // Open-addressing hash table (linear probing, power-of-two capacity) from packed beams to shot counts.
+  // The hash of every beam is stored alongside it, so probing and growing never rehash a key.
+
+  class BeamCountTable {
+
+    public:
+
+      explicit BeamCountTable(std::size_t expected_size = 16);
+
+      void add(const PackedBeam &beam, int count) { add(beam, PackedBeamHash()(beam), count); }
+      void add(const PackedBeam &beam, std::size_t hash, int count);
+
+      // Add all counts of another table to this one
+      void merge(const BeamCountTable &other);
+
+      std::size_t size() const { return size_; }
+
+      template <typename F>
+      void for_each(F &&f) const {
+        for (const auto &slot : slots_) {
+          if (slot.count > 0) {
+            f(slot.beam, slot.count);
+          }
+        }
+      }
+
+      // Beams and counts in beam order, i.e. the order of the beam bitstrings
+      std::vector<std::pair<PackedBeam, int>> sorted() const;
+
+    private:
+
+      struct Slot {
+        std::size_t hash = 0;
+        int count = 0; // zero marks an empty slot
+        PackedBeam beam;
+      };
+
+      void grow();
+
+      std::vector<Slot> slots_;
+      std::size_t mask_;
+      std::size_t size_ = 0;
+
+  };
+
+  // Shot counts of one shard, split into one table per partition of the hash space.
+  // Partitions are chosen from the high hash bits, table slots from the low ones.
+
+  class PartitionedBeamCounts {
+
+    public:
+
+      PartitionedBeamCounts(std::size_t nb_partitions, std::size_t expected_size)
+          : tables_(nb_partitions, BeamCountTable(expected_size / nb_partitions)) {}
+
+      void add(const PackedBeam &beam, int count) {
+        const std::size_t hash = PackedBeamHash()(beam);
+        const std::uint64_t high = std::uint64_t(hash) >> 32;
+        tables_[static_cast<std::size_t>((high * tables_.size()) >> 32)].add(beam, hash, count);
+      }
+
+      std::size_t nb_partitions() const { return tables_.size(); }
+      const BeamCountTable &partition(std::size_t index) const { return tables_[index]; }
+
+    private:
+
+      std::vector<BeamCountTable> tables_;
+
+  };
+
+  // Sharded map/reduce over n items producing beams. produce(begin, end, counts) is called once per shard
+  // of [0, n), possibly concurrently, and adds the beams of items [begin, end) to counts. Partitions are
+  // then reduced in parallel and the beams returned in beam order. nb_threads <= 0 uses the whole default
+  // thread pool; fewer than min_items_per_shard items per shard are processed on the calling thread.
+  std::vector<std::pair<PackedBeam, int>> aggregate_sharded(
+      std::size_t n, int nb_threads, std::size_t min_items_per_shard,
+      const std::function<void(std::size_t, std::size_t, PartitionedBeamCounts &)> &produce);
+
+  // Collapse every measured string into its beam and sum shot counts per beam, in beam order.
+  // Outcomes are sharded across the default thread pool and each shard fills per-partition tables,
+  // which are then reduced partition by partition in parallel. nb_threads <= 0 uses the whole pool;
+  // small inputs are aggregated on the calling thread.
+  std::vector<std::pair<PackedBeam, int>> aggregate_beams(const std::map<std::string, int> &measurements,
+                                                          const BeamCollapser &collapser,
+                                                          int nb_threads = 0);
+
+  // Sequential stopping
+
+  // Confidence that the leading beam, drawn leader times, is more probable than the runner-up, drawn
+  // runner_up times. Given their total, the leader's count would be binomial with p = 1/2 if both were
+  // equally probable; this is the one-sided normal approximation Phi((leader - runner_up)/sqrt(total)).
+  double leader_confidence(int leader, int runner_up);
+
+}
@@ -0,0 +1,90 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace qristal {
+
+  // Packed beam key
+
+  // Symbols are stored nq_symbol bits wide in 64-bit words, first symbol in the most significant field.
+  // Fields never straddle a word boundary, and unused fields are left as zero. Because a beam never
+  // contains the null symbol (0), the zero padding acts as a terminator, so comparing the word vectors
+  // lexicographically gives exactly the ordering of the equivalent beam bitstrings.
+
+  struct PackedBeam {
+
+    std::vector<std::uint64_t> words;
+    int length = 0; // number of symbols in the beam
+
+    bool operator==(const PackedBeam &other) const { return words == other.words; }
+    bool operator<(const PackedBeam &other) const { return words < other.words; }
+
+  };
+
+  struct PackedBeamHash {
+    std::size_t operator()(const PackedBeam &beam) const;
+  };
+
+  // Beam collapse engine
+
+  // Converts measured strings into beams by contracting repeated symbols and then removing nulls,
+  // working on bit-packed symbols rather than substrings. Repeats and nulls are found for a whole
+  // word of symbols at once with shifts, masks and SIMD-within-a-register zero-field tests.
+  // Common symbol widths (1-8, 10, 12 and 16 qubits) use a collapse loop specialised at compile time;
+  // other widths fall back to a generic loop with the same behaviour.
+
+  // Inputs:
+  // nb_timesteps: The number of symbols in each measured string
+  // nq_symbol: The number of qubits (bits) per symbol, from 1 to 32
+  // is_msb: Whether to reverse the symbol order of the beam, as done for msb-ordered accelerators
+
+  class BeamCollapser {
+
+    public:
+
+      BeamCollapser(int nb_timesteps, int nq_symbol, bool is_msb = false);
+
+      // Pack the first nb_timesteps symbols of a measured bitstring into words
+      void pack(const std::string &bitstring, std::vector<std::uint64_t> &words) const;
+
+      // Collapse packed symbols (as laid out by pack) into a beam. beam is overwritten, reusing its storage.
+      void collapse_packed(const std::uint64_t *words, PackedBeam &beam) const;
+
+      // Collapse a measured bitstring into a beam
+      void collapse(const std::string &bitstring, PackedBeam &beam) const;
+      PackedBeam collapse(const std::string &bitstring) const;
+
+      // Bitstring form of a beam, identical to the string-based kernel output
+      std::string to_string(const PackedBeam &beam) const;
+
+      int nb_timesteps() const { return nb_timesteps_; }
+      int nq_symbol() const { return nq_symbol_; }
+      int symbols_per_word() const { return symbols_per_word_; }
+      int nb_words() const { return nb_words_; }
+
+    private:
+
+      // Collapse loop for symbols of width W, or of any width if W is 0
+      template <int W>
+      static void collapse_words(const BeamCollapser &collapser, const std::uint64_t *words, PackedBeam &beam);
+
+      void (*collapse_fn_)(const BeamCollapser &, const std::uint64_t *, PackedBeam &);
+
+      int nb_timesteps_;
+      int nq_symbol_;
+      bool is_msb_;
+      int symbols_per_word_;
+      int nb_words_;
+
+      std::uint64_t field_mask_; // nq_symbol_ low bits
+      std::uint64_t low_bits_;   // lowest bit of every field
+      std::uint64_t high_bits_;  // highest bit of every field
+
+  };
+
+}
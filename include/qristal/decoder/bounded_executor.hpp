@@ -0,0 +1,65 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace qristal {
+
+  // Worker threads with a bounded number of tasks in flight
+
+  // Unlike ThreadPool, which never refuses work, at most max_pending tasks are queued or running at any
+  // one time. submit waits for room and try_submit gives up, so a producer that runs ahead of the workers
+  // is held back (or told to drop work) rather than growing the queue without bound. Tasks run in the
+  // order submitted and must not throw.
+
+  class BoundedExecutor {
+
+    public:
+
+      // nb_workers and max_pending of 0 count as 1
+      BoundedExecutor(std::size_t nb_workers, std::size_t max_pending);
+
+      // Runs every task already submitted, then joins the workers
+      ~BoundedExecutor();
+
+      BoundedExecutor(const BoundedExecutor &) = delete;
+      BoundedExecutor &operator=(const BoundedExecutor &) = delete;
+
+      // Queue a task, first waiting while max_pending tasks are in flight
+      void submit(std::function<void()> task);
+
+      // Queue a task if fewer than max_pending are in flight, else return false
+      bool try_submit(std::function<void()> task);
+
+      // Wait until every task submitted has finished
+      void wait_idle();
+
+      // Tasks queued or running
+      std::size_t pending();
+
+      std::size_t size() const { return workers_.size(); }
+      std::size_t max_pending() const { return max_pending_; }
+
+    private:
+
+      void run();
+
+      std::vector<std::thread> workers_;
+      std::size_t max_pending_;
+      std::deque<std::function<void()>> tasks_;
+      std::size_t running_ = 0;
+      std::mutex mutex_;
+      std::condition_variable wake_;  // workers: a task or stop
+      std::condition_variable room_;  // producers: a task finished
+      bool stop_ = false;
+
+  };
+
+}
@@ -0,0 +1,65 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "qristal/decoder/probability_table.hpp"
+
+#include <vector>
+
+namespace qristal {
+
+  // Log-domain helpers
+
+  // Log of zero probability. A finite floor rather than -infinity keeps the branch-free log-sum-exp
+  // loops free of inf - inf, so they can be vectorised.
+  constexpr double log_zero = -1e30;
+
+  // log(exp(a) + exp(b))
+  double log_sum_exp(double a, double b);
+
+  // CTC reference engine
+
+  // Exact, classical CTC beam probabilities for a probability table whose rows are timesteps and whose
+  // columns are symbols, with column 0 the null symbol. The probability of a beam is the total probability
+  // of all strings that collapse to it (repeats contracted, then nulls removed).
+
+  struct ScoredBeam {
+    std::vector<int> symbols; // non-null symbols in time order
+    double log_probability;
+  };
+
+  class CtcReference {
+
+    public:
+
+      explicit CtcReference(const ProbabilityTable &probability_table);
+
+      // Exact log probability of a beam, by the CTC forward algorithm over the null-interleaved labels
+      double log_probability(const std::vector<int> &beam) const;
+
+      // Most probable beams, most probable first. A log-domain prefix beam search keeps the beam_width most
+      // probable prefixes at every timestep; the surviving candidates are then rescored exactly with the
+      // forward algorithm and the top_k returned. The probabilities returned are always exact; the ranking
+      // is exact whenever beam_width is at least the number of distinct prefixes, e.g. for short utterances.
+      std::vector<ScoredBeam> top_beams(int top_k, int beam_width) const;
+
+      // The beam of the most probable single string, i.e. the per-timestep argmax collapsed, with its exact
+      // beam probability. A lower bound on the best beam at the cost of one pass over the table.
+      ScoredBeam best_path() const;
+
+      // The most probable string that collapses to beam, one symbol (0 for null) per timestep, by Viterbi
+      // over the same labels as log_probability. Throws if no string of nonzero probability collapses to it.
+      std::vector<int> align(const std::vector<int> &beam) const;
+
+      int nb_timesteps() const { return nb_timesteps_; }
+      int nb_symbols() const { return nb_symbols_; }
+
+    private:
+
+      int nb_timesteps_;
+      int nb_symbols_;
+      std::vector<double> log_table_; // row-major, nb_timesteps_ x nb_symbols_
+
+  };
+
+}
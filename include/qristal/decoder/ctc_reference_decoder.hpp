@@ -0,0 +1,59 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "qristal/decoder/probability_table.hpp"
+
+#include "Algorithm.hpp"
+#include "xacc.hpp"
+
+#include <string>
+#include <vector>
+
+namespace qristal {
+
+  // Classical reference decoder: the most probable beams of a probability table, with their exact CTC
+  // probabilities, for validating the quantum and simplified decoders and for decoding short utterances
+  // outright. Beams are reported under the same buffer keys and in the same bitstring format as the
+  // simplified decoder, so results of the two can be compared directly:
+  // best_beam, beam_N, beam_count_N (expected counts for the given shots), nb_beams,
+  // plus beam_probability_N (exact probability of beam N).
+
+  class CtcReferenceDecoder : public xacc::Algorithm {
+
+    private:
+
+      //Probability table. Rows represent timesteps, columns symbols, column 0 the null symbol. Given as nested
+      //vectors or as a ProbabilityTable.
+      ProbabilityTable probability_table;
+
+      int nq_symbol;          // Qubits per symbol in the beam bitstrings
+      int top_k = 10;         // Number of beams reported
+      int beam_width = 64;    // Prefixes kept per timestep by the beam search
+      int shots = 1024;       // Shots the expected beam counts are given for
+
+      // Bitstring format of the simplified decoder on the same accelerator: aer reports measured strings
+      // in reverse qubit order, and is_msb reverses the symbol order of the beam
+      bool reversed_bit_order = false;
+      bool is_msb = false;
+
+    public:
+
+      bool initialize(const xacc::HeterogeneousMap &parameters) override;
+      const std::vector<std::string> requiredParameters() const override;
+
+      void
+      execute(const std::shared_ptr<xacc::AcceleratorBuffer> buffer) const override;
+
+      const std::string name() const override {
+        return "ctc-reference-decoder";
+      }
+      const std::string description() const override {
+        return "Classical CTC Reference Decoder";
+      }
+
+      DEFINE_ALGORITHM_CLONE(CtcReferenceDecoder)
+
+  };
+
+}
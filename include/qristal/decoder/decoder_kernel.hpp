@@ -35,6 +35,12 @@ namespace qristal {
   // evaluation_bits: The register of qubits used to store the output of the amplitude estimation
   // precision_bits: A list of the number of precision qubits used per metric qubit during amplitude estimation
   // qubits_ancilla_pool: The register of qubits used as ancilla
+  // metric_state_prep: The state preparation preceding the kernel, run again (followed by the cascade) by the
+  //   amplitude estimation adder. It is shared, not copied, and left unchanged.
+  // compaction: How flagged symbols are moved to the end of the string, "cascade" (default) or "network".
+  //   The cascade is a chain of controlled swaps with O(L^2) depth. The network routes every symbol to the
+  //   same place in O(log^2 L) depth, but needs compaction_network_ancilla(L) more qubits from the pool
+  //   (see resource_plan.hpp).
 
   class DecoderKernel : public xacc::quantum::Circuit {
 
@@ -49,5 +55,4 @@ namespace qristal {
       DEFINE_CLONE(DecoderKernel);
 
   };
-
 }
@@ -0,0 +1,77 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "qristal/decoder/beam_collapse.hpp"
+#include "qristal/decoder/probability_table.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace qristal {
+
+  // Alias table
+
+  // Walker/Vose alias table for drawing symbols from one row of the probability table in O(1).
+  // Rows are normalised, so they need not sum to exactly 1.
+
+  class AliasTable {
+
+    public:
+
+      explicit AliasTable(const std::vector<float> &probabilities);
+
+      // Draw a symbol from 64 uniformly random bits: the high half picks a column, the low half the coin
+      int sample(std::uint64_t random) const {
+        const std::uint64_t column = ((random >> 32) * nb_symbols_) >> 32;
+        return std::uint32_t(random) < threshold_[column] ? int(column) : alias_[column];
+      }
+
+      int nb_symbols() const { return nb_symbols_; }
+
+    private:
+
+      std::uint64_t nb_symbols_;
+      std::vector<std::uint64_t> threshold_; // keep probability of each column, scaled by 2^32
+      std::vector<int> alias_;
+
+  };
+
+  // Direct sampler
+
+  // The Ry-encoded string state prepared by the "ry" method is a product state over timesteps, so its
+  // measurement outcomes can be drawn classically and exactly, one alias-table draw per timestep, without
+  // building or simulating a circuit. Each draw is written straight into the packed layout used by
+  // BeamCollapser, in the bit order the measured string would have on the emulated accelerator, so the
+  // beams (and their statistics) are identical to those of the simulated circuit.
+
+  // Inputs:
+  // probability_table: Rows represent timesteps, columns symbols
+  // nq_symbol: The number of qubits per symbol, at least ceil(log2(number of symbols))
+  // reversed_bit_order: Emulate accelerators that report the measured string in reverse qubit order (aer)
+  // row_symbols: If given, the symbol drawn for each column of each row, e.g. of a code table (see
+  //              SymbolCodebook::symbols), so that beams come out over the symbols rather than the columns
+
+  class DirectSampler {
+
+    public:
+
+      DirectSampler(const ProbabilityTable &probability_table, int nq_symbol,
+                    bool reversed_bit_order = false, const std::vector<std::vector<int>> &row_symbols = {});
+
+      // Draw shots and sum their counts per beam, in beam order. Shots are sharded across the default
+      // thread pool, each shard with its own random stream derived from seed; the result for a given seed
+      // depends on the number of shards but not on thread scheduling. nb_threads <= 0 uses the whole pool.
+      std::vector<std::pair<PackedBeam, int>> sample_beams(int shots, const BeamCollapser &collapser,
+                                                           std::uint64_t seed, int nb_threads = 0) const;
+
+    private:
+
+      std::vector<AliasTable> rows_;                 // in measured string order
+      std::vector<std::vector<std::uint64_t>> fields_; // packed field value of every symbol of every row
+      int nq_symbol_;
+
+  };
+
+}
@@ -0,0 +1,102 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace qristal {
+
+  // Thread-safe least-recently-used cache
+
+  // Values are built on a miss by a caller-supplied factory, outside the lock, so a slow build does not
+  // block lookups of other keys. If two threads miss on the same key at once, both build and the first
+  // value inserted is kept and returned to both. A capacity of 0 disables caching.
+
+  template <typename Key, typename Value, typename Hash = std::hash<Key>>
+  class LruCache {
+
+    public:
+
+      explicit LruCache(std::size_t capacity) : capacity_(capacity) {}
+
+      // Cached value for key, built with factory() on a miss. The flag is true on a hit.
+      template <typename Factory>
+      std::pair<Value, bool> get_or_create(const Key &key, Factory &&factory) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          auto iter = index_.find(key);
+          if (iter != index_.end()) {
+            entries_.splice(entries_.begin(), entries_, iter->second);
+            hits_++;
+            return {iter->second->second, true};
+          }
+          misses_++;
+        }
+
+        Value value = factory();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (capacity_ == 0) {
+          return {value, false};
+        }
+        auto iter = index_.find(key);
+        if (iter != index_.end()) {
+          return {iter->second->second, false};
+        }
+        entries_.emplace_front(key, value);
+        index_.emplace(key, entries_.begin());
+        evict();
+        return {value, false};
+      }
+
+      void set_capacity(std::size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+        evict();
+      }
+
+      void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        index_.clear();
+        entries_.clear();
+      }
+
+      std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+      }
+
+      std::size_t hits() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_;
+      }
+
+      std::size_t misses() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+      }
+
+    private:
+
+      void evict() {
+        while (entries_.size() > capacity_) {
+          index_.erase(entries_.back().first);
+          entries_.pop_back();
+        }
+      }
+
+      std::size_t capacity_;
+      std::list<std::pair<Key, Value>> entries_; // most recently used first
+      std::unordered_map<Key, typename std::list<std::pair<Key, Value>>::iterator, Hash> index_;
+      std::size_t hits_ = 0;
+      std::size_t misses_ = 0;
+      mutable std::mutex mutex_;
+
+  };
+
+}
@@ -0,0 +1,98 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace qristal {
+
+  // Flat probability table
+
+  // Rows represent timesteps, columns symbols, column 0 the null symbol, stored row-major in one block.
+  // The table is immutable and held by a shared handle, so copying it (into a HeterogeneousMap, a decoder
+  // or another thread) copies no probabilities. A table either owns a 64-byte aligned copy of its
+  // probabilities, or is a view over memory owned by the caller, e.g. a network's output tensor, which
+  // must outlive it unless an owner keeping it alive is given. Rows are spans, so the table reads like the
+  // nested vectors it replaces: table.size(), table[t][s] and range-for over the rows.
+
+  class ProbabilityTable {
+
+    public:
+
+      static constexpr std::size_t alignment = 64;
+
+      using Row = std::span<const float>;
+
+      class const_iterator {
+        public:
+          using iterator_category = std::forward_iterator_tag;
+          using value_type = Row;
+          using difference_type = std::ptrdiff_t;
+          using pointer = void;
+          using reference = Row;
+
+          const_iterator() = default;
+          const_iterator(const float *row, std::size_t nb_symbols) : row_(row), nb_symbols_(nb_symbols) {}
+
+          Row operator*() const { return Row(row_, nb_symbols_); }
+          const_iterator &operator++() {
+            row_ += nb_symbols_;
+            return *this;
+          }
+          const_iterator operator++(int) {
+            const_iterator before = *this;
+            ++*this;
+            return before;
+          }
+          bool operator==(const const_iterator &other) const { return row_ == other.row_; }
+
+        private:
+          const float *row_ = nullptr;
+          std::size_t nb_symbols_ = 0;
+      };
+
+      ProbabilityTable() = default;
+
+      // A copy of a nested table, whose rows must all have the same length. Not explicit, so that a nested
+      // table may be passed wherever a ProbabilityTable is taken.
+      ProbabilityTable(const std::vector<std::vector<float>> &rows);
+      ProbabilityTable(std::initializer_list<std::initializer_list<float>> rows)
+          : ProbabilityTable(std::vector<std::vector<float>>(rows.begin(), rows.end())) {}
+
+      // A copy of nb_timesteps*nb_symbols probabilities, row-major
+      ProbabilityTable(const float *data, std::size_t nb_timesteps, std::size_t nb_symbols);
+
+      // No copy: a view over nb_timesteps*nb_symbols probabilities, row-major, owned by the caller. owner,
+      // if given, is kept alive as long as any copy of the table.
+      static ProbabilityTable view(const float *data, std::size_t nb_timesteps, std::size_t nb_symbols,
+                                   std::shared_ptr<const void> owner = nullptr);
+
+      std::size_t nb_timesteps() const { return nb_timesteps_; }
+      std::size_t nb_symbols() const { return nb_symbols_; }
+      std::size_t size() const { return nb_timesteps_; }
+      bool empty() const { return nb_timesteps_ == 0; }
+
+      const float *data() const { return data_.get(); }
+      Row operator[](std::size_t t) const { return Row(data_.get() + t * nb_symbols_, nb_symbols_); }
+      float operator()(std::size_t t, std::size_t s) const { return data_.get()[t * nb_symbols_ + s]; }
+
+      const_iterator begin() const { return const_iterator(data_.get(), nb_symbols_); }
+      const_iterator end() const { return const_iterator(data_.get() + nb_timesteps_ * nb_symbols_, nb_symbols_); }
+
+      // A nested copy, for the circuit builders of the core that take one
+      std::vector<std::vector<float>> to_rows() const;
+
+    private:
+
+      std::shared_ptr<const float> data_;
+      std::size_t nb_timesteps_ = 0;
+      std::size_t nb_symbols_ = 0;
+
+  };
+
+}
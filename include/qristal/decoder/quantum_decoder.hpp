@@ -2,6 +2,10 @@
 
 #pragma once
 
+#include "qristal/decoder/accelerator_pool.hpp"
+#include "qristal/decoder/probability_table.hpp"
+#include "qristal/decoder/timestep_pruning.hpp"
+
 #include "Algorithm.hpp"
 #include "IRProvider.hpp"
 #include "InstructionIterator.hpp"
@@ -11,9 +15,12 @@
 #include <assert.h>
 #include <cmath>
 #include <iomanip>
+#include <map>
 #include <numeric>
+#include <optional>
 #include <random>
 #include <sstream>
+#include <string>
 #include <vector>
 
 namespace qristal {
@@ -38,13 +45,24 @@ namespace qristal {
         state_prep_circuit_gen_;
 
       std::function<int(int)> f_score_; //Return the score for a bitstring
-      xacc::Accelerator *qpu_;          //Accelerator, optional
+      //Accelerator. An accelerator instance given as qpu is used as is, so execute must then not run on
+      //several threads at once. Otherwise each thread gets its own from accelerator_pool_: the
+      //accelerator_pool option (an AcceleratorPool pointer, see accelerator_pool.hpp), else a pool of
+      //the qpu named (qpp by default) owned by the decoder, or takes turns on it if the backend is shared.
+      //The circuit caches are locked.
+      xacc::Accelerator *qpu_;
+      AcceleratorPool *accelerator_pool_ = nullptr;
+      std::shared_ptr<AcceleratorPool> owned_accelerator_pool_;
+
+      xacc::Accelerator *accelerator() const { return accelerator_pool_ ? accelerator_pool_->get() : qpu_; }
 
       int BestScore; //Tracking the best score, default is 0 if none provided
 
       //Qubit registers. These are optional but if any one of them are provided
       //then they should all be provided. Default register structure:
       //|trial_qubits>|flag_qubit>|qubits_best_score>|qubits_ancilla_oracla>
+      //Without qubits_metric, all registers are laid out by layout_quantum_decoder
+      //(see resource_plan.hpp) from the probability table and metric_precision.
       std::vector<int> qubits_best_score;
       std::vector<int> qubits_total_metric_buffer;
       int N_TRIALS;
@@ -53,12 +71,39 @@ namespace qristal {
       //"canonical" - canonical exponential search (default)
       //"CQAE" - using canonical QAE
       //"MLQAE" - using MLQAE
+      //Execute reports the oracle queries of the search as oracle_queries, and its time as search_seconds.
       std::string method;
+      //Settings of the amplitude estimation methods, passed on to exponential-search:
+      //CQAE_num_evaluation_qubits, MLQAE_num_runs and MLQAE_num_shots
+      std::map<std::string, int> qae_options;
 
-      //Parameters for W prime unitary
-      std::vector<std::vector<float>> probability_table;
+      //Parameters for W prime unitary. probability_table is given as nested vectors, copied once, or as a
+      //ProbabilityTable, e.g. a view over the network's output, shared without a copy.
+      ProbabilityTable probability_table;
       int iteration;
 
+      //Pruning of decided null and repeat timesteps (see timestep_pruning.hpp), if either threshold is below
+      //1. probability_table is then the pruned table, and execute reports blanks_pruned, repeats_merged and
+      //discarded_probability. Beams of the pruned table are beams of the original. Registers given
+      //explicitly for the original table are cut to the pruned table's plan, and initialize fails if one
+      //is too small for it; a dry run reports whether they fit as plan_registers_ok.
+      double prune_blank_threshold;
+      double prune_repeat_threshold;
+      std::optional<PrunedTable> pruned_;
+
+      //Batch of probability tables, given as probability_tables instead of probability_table. Each is
+      //decoded as if given alone, into the child buffer "utterance_<i>"; execute reports best_strings,
+      //best_scores, nb_utterances, batch_seconds and utterances_per_second. Batches run across the thread
+      //pool, unless on a qpu given as an accelerator instance, one table at a time.
+      std::vector<std::vector<std::vector<float>>> probability_tables;
+      xacc::HeterogeneousMap parameters_; //as initialised, for the decoders of a batch
+
+      void execute_batch(const std::shared_ptr<xacc::AcceleratorBuffer> buffer) const;
+
+      //initialize for one table given apart from the parameters, which are otherwise read as is: the
+      //decoders of a batch, which prune and encode their own table
+      bool initialize_table(const xacc::HeterogeneousMap &parameters, const ProbabilityTable &table);
+
       //Qubit register for U prime and Q prime
       std::vector<int> qubits_metric;
       std::vector<int> qubits_string;
@@ -70,6 +115,37 @@ namespace qristal {
       std::vector<int> qubits_ancilla_pool;
       std::vector<int> qubits_beam_metric;
 
+      //Decoder kernel compaction mode: "cascade" (default) or "network", which has
+      //polylog depth but needs compaction_network_ancilla(L) more ancilla qubits
+      std::string compaction;
+
+      //Stopping policies of the N_TRIALS loop, disabled when 0 (patience, time_budget) or negative
+      //(target_score). Execute reports the one that fired as stop_reason ("trials" if none did),
+      //with trials_run, trials_saved, best_score and best_string. best_string is the string register
+      //after compaction, qubits_string in order, so symbol k on bits k*S to k*S+S-1, least significant
+      //first. Only its first best_beam_length symbols, read from the superfluous flags measured with
+      //it, form the beam (see compacted_beam in streaming.hpp); the rest are left over from compaction.
+      int patience;       //trials in a row without a better score
+      int target_score;   //best score good enough to stop at
+      double time_budget; //seconds
+
+      //Classical warm start of the exponential search: "none" (default), "greedy" for the beam of the
+      //most probable string, or "beam" for a prefix beam search of warm_start_beam_width prefixes. The
+      //search then starts from the larger of BestScore and a lower bound of that beam's metric (see
+      //beam_metric_lower_bound), with the beam as best_string until a trial beats it.
+      std::string warm_start;
+      int warm_start_beam_width;
+
+      //If true, the ancillas of the state preparation circuit are remapped onto as few pool qubits as
+      //gate-level liveness allows (see ancilla_liveness.hpp), and the decode only allocates the qubits used.
+      //qubits_ancilla_pool may then be smaller than the plan's num_ancilla, down to the ancilla_pool_used
+      //execute reports, as long as the remapped circuits fit in it.
+      bool reuse_ancilla;
+
+      //If true, execute only reports the resource plan of the decode (see resource_plan.hpp)
+      //as plan_* buffer information, without building or running any circuit
+      bool dry_run;
+
     public:
 
       bool initialize(const xacc::HeterogeneousMap &parameters) override;
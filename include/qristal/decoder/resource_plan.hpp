@@ -0,0 +1,93 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "qristal/decoder/probability_table.hpp"
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace qristal {
+
+  // Resource plan for the quantum decoder
+
+  // Qubit counts, and gate counts and depth per circuit block, worked out from the problem size alone,
+  // without building or simulating any circuit. Blocks are counted in the gates the decoder itself adds:
+  // sub-circuits from qristal core (WPrime, UPrime, QPrime, RippleCarryAdder, SuperpositionAdder,
+  // CompareGT, ...) count as one gate each, and depth is in layers of those gates.
+
+  struct BlockCost {
+    std::map<std::string, std::size_t> gates; // count per gate or sub-circuit name
+    std::size_t depth = 0;
+  };
+
+  struct ResourcePlan {
+    int string_length;           // L
+    int alphabet_size;
+    int nq_symbol;               // S, qubits per symbol
+    int metric_precision;        // ml, qubits per letter metric
+    int string_metric_precision; // ms
+    int ae_precision;            // p, precision qubits of the metric amplitude estimation
+    int beam_metric_precision;   // mb
+    int num_ancilla;             // minimum size of qubits_ancilla_pool, the largest of stage_ancilla
+    int num_qubits;              // total qubits, with the minimum ancilla pool
+
+    // Ancilla qubits live at once in each stage of the decode: "state_prep", "decoder_kernel" (the
+    // compaction and superposition adder) and "oracle". Every stage returns its ancillas to |0> except the
+    // network compaction, whose tags stay live to the end of the decode and so count in every later stage.
+    std::map<std::string, int> stage_ancilla;
+
+    // Keyed by block: "w_prime", "init_repeat", "u_prime", "q_prime", "adder_chain", "decoder_kernel",
+    // "superposition_adder" and "oracle". The oracle is costed for a best score with every bit set.
+    std::map<std::string, BlockCost> blocks;
+  };
+
+  // Plan a decode of string_length timesteps over alphabet_size symbols, with metric_precision qubits per
+  // letter metric. nq_symbol defaults to the fewest qubits that hold alphabet_size symbols; compaction is
+  // the decoder kernel's compaction mode, "cascade" or "network".
+  ResourcePlan plan_quantum_decoder(int string_length, int alphabet_size, int metric_precision,
+                                    int nq_symbol = 0, const std::string &compaction = "cascade");
+
+  // Qubit registers of the quantum decoder
+
+  // A complete register layout for a plan, as QuantumDecoder takes it. Registers live for the whole decode
+  // come first, each on its own qubits, then the ancilla pool, which the stages of the decode share since
+  // each leaves it clean for the next (see ResourcePlan::stage_ancilla). num_qubits is the total.
+
+  struct DecoderLayout {
+    std::vector<int> qubits_metric;
+    std::vector<int> qubits_string;
+    std::vector<int> qubits_init_null;
+    std::vector<int> qubits_init_repeat;
+    std::vector<int> qubits_superfluous_flags;
+    std::vector<int> qubits_total_metric_buffer;
+    std::vector<int> qubits_beam_metric;
+    std::vector<int> qubits_best_score;
+    std::vector<int> qubits_ancilla_pool;
+    int num_qubits = 0;
+  };
+
+  DecoderLayout layout_quantum_decoder(const ResourcePlan &plan);
+
+  // Value of qubits_beam_metric for a beam of the given (natural log) probability: the superposition adder
+  // sums the strings of a beam on the scale of the string metric, so a beam of probability 1 scores
+  // 2^ms - 1. Rounded down and capped at mb bits. The circuit rounds every string separately, so the
+  // metric it measures for the same beam may differ from this by a few units.
+  int beam_metric_score(double log_probability, const ResourcePlan &plan);
+
+  // A score the circuit's metric for the beam does not fall below, from the circuit's encoding of the table:
+  // each timestep's letter metric is its probability rounded down to ml bits in qubits_metric, a string's
+  // metric is the sum of its letter metrics, and the superposition adder sums the metrics of the beam's
+  // strings into the mb-bit beam metric. Only strings of nonzero probability throughout are counted, so the
+  // bound holds whether or not the circuit also prepares the others. The warm start searches for beams
+  // scoring above the bound for its beam.
+  int beam_metric_lower_bound(const ProbabilityTable &probability_table, const std::vector<int> &beam,
+                              const ResourcePlan &plan);
+
+  // Number of ancilla qubits the "network" compaction of the decoder kernel takes from the pool, for a
+  // string of the given length
+  int compaction_network_ancilla(int string_length);
+
+}
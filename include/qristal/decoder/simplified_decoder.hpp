@@ -2,6 +2,11 @@
 
 #include "qristal/core/circuit_builders/ry_encoding.hpp"
 
+#include "qristal/decoder/accelerator_pool.hpp"
+#include "qristal/decoder/probability_table.hpp"
+#include "qristal/decoder/symbol_codebook.hpp"
+#include "qristal/decoder/timestep_pruning.hpp"
+
 #include "Algorithm.hpp"
 #include "IRProvider.hpp"
 #include "InstructionIterator.hpp"
@@ -11,8 +16,10 @@
 
 #include <assert.h>
 #include <cmath>
+#include <cstdint>
 #include <iomanip>
 #include <numeric>
+#include <optional>
 #include <random>
 #include <sstream>
 #include <vector>
@@ -25,21 +32,76 @@ namespace qristal {
 
     private:
 
-      // Function performs kernel operation post-measurement
-      std::function<std::string(std::string)> f_kernel_; //Converts selected ionput string to form of corresponding output string (beam)
-      xacc::Accelerator *qpu_;          //Accelerator, optional
+      //Accelerator. An accelerator instance given as qpu is used as is, so execute must then not run on
+      //several threads at once. Otherwise each thread gets its own from accelerator_pool_: the
+      //accelerator_pool option (an AcceleratorPool pointer, see accelerator_pool.hpp), else a pool of
+      //the qpu named (qpp by default) owned by the decoder, or takes turns on it if the backend is shared.
+      //The circuit caches are locked.
+      xacc::Accelerator *qpu_;
+      AcceleratorPool *accelerator_pool_ = nullptr;
+      std::shared_ptr<AcceleratorPool> owned_accelerator_pool_;
+
+      xacc::Accelerator *accelerator() const { return accelerator_pool_ ? accelerator_pool_->get() : qpu_; }
+      std::string qpu_name() const { return accelerator_pool_ ? accelerator_pool_->name() : qpu_->name(); }
       bool is_msb = false;    //
+      int num_threads = 0;    // Threads for beam aggregation, 0 for all hardware threads
+      int shots = 0;          // Shots drawn by "direct-sample" or a sequential decode, 0 to use the qpu
+                              // shots, or 1024 for "direct-sample", which does not use the qpu
+      std::optional<std::uint64_t> seed; // Seed for "direct-sample", random if not given
+      // Sequential decode, if shot_batch > 0: shots (the shots option, else the qpu's) are drawn shot_batch
+      // at a time and stop once the leading beam beats the runner-up at confidence (see leader_confidence).
+      // The buffer then reports the confidence reached and shots_used, but not the measurements.
+      int shot_batch = 0;
+      double confidence = 0.99;
 
       //Qubit registers
       std::vector<int> qubits_best_score;
 
       //Choose which method to encode strings and probabilities. Currently supported methods are:
       //"ry" - ry-rotations (default)
-      //"aa" - using Amplitude Amplification
+      //"aa" - using Amplitude Amplification of the good strings, those whose every symbol has at least
+      //        aa_threshold (default 0.5) times the probability of the most probable symbol of its
+      //        timestep, over aa_iterations Grover iterations (default -1, the optimal number). Needs
+      //        nb_timesteps + 1 qubits_ancilla, by default the qubits following qubits_string.
+      //"direct-sample" - draw the measured strings of the "ry" circuit classically from the probability table,
+      //                  without building or simulating a circuit, nor any accelerator: the qpu option
+      //                  only sets the bit order. Per-shot measurements are not added to the buffer.
       std::string method;
-
-      //Probability table
-      std::vector<std::vector<float>> probability_table;
+      double aa_threshold;
+      int aa_iterations;
+      std::vector<int> qubits_ancilla;
+
+      //Probability table, given as nested vectors, copied once, or as a ProbabilityTable, e.g. a view over the
+      //network's output, shared without a copy
+      ProbabilityTable probability_table;
+
+      //Pruning of decided null and repeat timesteps (see timestep_pruning.hpp), if either threshold is below
+      //1. probability_table is then the pruned table, and execute reports blanks_pruned, repeats_merged and
+      //discarded_probability. Beams of the pruned table are beams of the original.
+      double prune_blank_threshold;
+      double prune_repeat_threshold;
+      std::optional<PrunedTable> pruned_;
+
+      //Per-timestep symbol codebook (see symbol_codebook.hpp), if codebook_top_k > 0 or codebook_mass < 1.
+      //probability_table is then the code table, encoded on the first nb_timesteps*nq_code qubits of
+      //qubits_string, and measured codes are translated back to symbols of nq_symbol bits before the
+      //beams are collapsed. execute reports nq_code and codebook_discarded_probability.
+      int codebook_top_k;
+      double codebook_mass;
+      std::optional<SymbolCodebook> codebook_;
+
+      //Batch of probability tables, given as probability_tables instead of probability_table. Each is
+      //decoded as if given alone, into the child buffer "utterance_<i>"; execute reports best_beams,
+      //nb_utterances, batch_seconds and utterances_per_second. Batches run across the thread pool, unless
+      //the circuits run on a qpu given as an accelerator instance, one table at a time.
+      std::vector<std::vector<std::vector<float>>> probability_tables;
+      xacc::HeterogeneousMap parameters_; //as initialised, for the decoders of a batch
+
+      void execute_batch(const std::shared_ptr<xacc::AcceleratorBuffer> buffer) const;
+
+      //initialize for one table given apart from the parameters, which are otherwise read as is: the
+      //decoders of a batch, which prune and encode their own table
+      bool initialize_table(const xacc::HeterogeneousMap &parameters, const ProbabilityTable &table);
 
       //qubits encoding string
       std::vector<int> qubits_string;
@@ -61,6 +123,7 @@ namespace qristal {
       int nb_timesteps;
       int nq_string;
       int nq_symbol;
+      int nq_code;    // qubits per timestep of the encoded table, nq_symbol unless a codebook is used
 
 
       const std::string name() const override {
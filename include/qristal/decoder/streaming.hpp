@@ -0,0 +1,79 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace qristal {
+
+  // Sliding-window stitching
+
+  // Splits an utterance arriving frame by frame (rows of a probability table) into windows of
+  // window_size timesteps, starting every hop timesteps, so that consecutive windows overlap by
+  // window_size - hop. Each window is decoded on its own into a beam; the beam is aligned with the window
+  // (see CtcReference::align) and the frames up to the middle of the overlap with the next window are
+  // committed. Committed frames are collapsed by the CTC rules across window boundaries, so a symbol held
+  // over a seam, or repeated with a null at the seam, comes out as it would from the whole utterance.
+  // Only the current window's frames are kept, so memory and decoding work per frame are bounded.
+
+  class WindowStitcher {
+
+    public:
+
+      // 0 < hop <= window_size
+      WindowStitcher(int window_size, int hop);
+
+      // Add a frame. Returns true when a full window is ready to be decoded.
+      bool push(std::vector<float> frame);
+
+      // End of the utterance. Returns true when frames are left to decode, as one last, shorter window.
+      bool finish();
+
+      // The window to decode
+      const std::vector<std::vector<float>> &window() const { return frames_; }
+
+      // Stitch in the beam decoded from window(): commits its frames up to the middle of the overlap with
+      // the next window (to the end after finish) and slides the window on by hop.
+      void commit(const std::vector<int> &beam);
+
+      // Symbols of the committed frames, final
+      const std::vector<int> &committed() const { return committed_; }
+
+      // Partial hypothesis: the committed symbols followed by those of the last window's uncommitted frames
+      std::vector<int> hypothesis() const;
+
+      int frames_seen() const { return frames_seen_; }
+      int frames_committed() const { return frames_committed_; }
+
+    private:
+
+      int window_size_;
+      int hop_;
+      std::vector<std::vector<float>> frames_; // from frame window_start_ on
+      int window_start_ = 0;
+      int frames_seen_ = 0;
+      int frames_committed_ = 0;
+      bool finished_ = false;
+
+      std::vector<int> committed_;
+      int previous_label_ = 0;       // label of the last committed frame
+      std::vector<int> tentative_;   // labels of the frames decoded but not yet committed
+
+  };
+
+  // Beam of a string of symbols, one per timestep: repeats contracted, then nulls removed
+  std::vector<int> ctc_collapse(const std::vector<int> &labels);
+
+  // Symbols of a beam bitstring of nq_symbol-bit symbols as reported by the simplified decoder: in time
+  // order, or reverse time order if exactly one of is_msb and reversed_bit_order is set, each written least
+  // significant bit first, or most significant first if reversed_bit_order (as for qpu "aer")
+  std::vector<int> beam_symbols(const std::string &bitstring, int nq_symbol, bool is_msb,
+                                bool reversed_bit_order = false);
+
+  // Beam of the quantum decoder's best_string, the compacted string register: its first beam_length
+  // symbols, each least significant bit first as the register is measured. The symbols after them are left
+  // over from compaction, and are not part of the beam.
+  std::vector<int> compacted_beam(const std::string &best_string, int beam_length, int nq_symbol);
+
+}
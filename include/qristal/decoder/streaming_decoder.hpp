@@ -0,0 +1,164 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "qristal/decoder/accelerator_pool.hpp"
+#include "qristal/decoder/ctc_reference.hpp"
+#include "qristal/decoder/streaming.hpp"
+
+#include "xacc.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace qristal {
+
+  // Streaming decoder
+
+  // Decodes an utterance of any length as its frames arrive, by decoding overlapping windows of
+  // window_size timesteps (see WindowStitcher), so that the qubits and gates of each decode depend on the
+  // window size only. push returns true whenever a window has been decoded, i.e. every hop frames, after
+  // which hypothesis() holds the partial hypothesis; finish decodes what is left.
+  //
+  // Windows are decoded by a function returning the window's beam, or by an xacc decoder:
+  // "simplified-decoder": the window's best_beam. qubits_string, if given, must cover a full window.
+  // "quantum-decoder": the first best_beam_length symbols of the window's best_string (see compacted_beam).
+  // A window for which the decoder finds no string, or only one the window cannot produce, keeps its best
+  // path.
+  // The probability_table option is set to each window in turn.
+
+  class StreamingDecoder {
+
+    public:
+
+      using WindowDecoder = std::function<std::vector<int>(const std::vector<std::vector<float>> &)>;
+
+      StreamingDecoder(WindowDecoder decode, int window_size, int hop)
+          : decode_(std::move(decode)), stitcher_(window_size, hop) {}
+
+      StreamingDecoder(const std::string &decoder, xacc::HeterogeneousMap options, int window_size, int hop)
+          : decode_(xacc_window_decoder(decoder, std::move(options))), stitcher_(window_size, hop) {}
+
+      // Add a frame, a row of the probability table. Returns true if the hypothesis was updated.
+      bool push(std::vector<float> frame) {
+        if (!stitcher_.push(std::move(frame))) {
+          return false;
+        }
+        stitcher_.commit(decode_(stitcher_.window()));
+        return true;
+      }
+
+      // End of the utterance: decode the frames left, after which hypothesis() is final
+      void finish() {
+        if (stitcher_.finish()) {
+          stitcher_.commit(decode_(stitcher_.window()));
+        }
+      }
+
+      // Committed symbols followed by the tentative symbols of the last window
+      std::vector<int> hypothesis() const { return stitcher_.hypothesis(); }
+      const std::vector<int> &committed() const { return stitcher_.committed(); }
+
+      const WindowStitcher &stitcher() const { return stitcher_; }
+
+    private:
+
+      // The beam decoded, or the window's best path if the beam has symbols outside the table or zero
+      // probability, as a noisy qpu may return
+      static std::vector<int> feasible(const std::vector<std::vector<float>> &window, std::vector<int> beam) {
+        const int nb_symbols = window[0].size();
+        for (int symbol : beam) {
+          if (symbol <= 0 || symbol >= nb_symbols) {
+            return CtcReference(window).best_path().symbols;
+          }
+        }
+        CtcReference reference(window);
+        if (reference.log_probability(beam) <= log_zero / 2) {
+          return reference.best_path().symbols;
+        }
+        return beam;
+      }
+
+      // Qubits per symbol of a window, at least one
+      static int window_nq_symbol(const std::vector<std::vector<float>> &window) {
+        return std::max(1, (int)std::ceil(std::log2(window[0].size())));
+      }
+
+      // The decoder is built once, and initialised for each window. Unless given a qpu instance or an
+      // accelerator pool, it is given a pool of the qpu named (qpp by default) shared by every window.
+      static WindowDecoder xacc_window_decoder(const std::string &decoder, xacc::HeterogeneousMap options) {
+        if (decoder != "simplified-decoder" && decoder != "quantum-decoder") {
+          throw std::runtime_error("Unknown decoder " + decoder + " for streaming!\n");
+        }
+        auto algorithm = xacc::getService<xacc::Algorithm>(decoder);
+        std::string qpu_name = options.stringExists("qpu") ? options.getString("qpu") : "qpp";
+        std::shared_ptr<AcceleratorPool> pool;
+        if (options.pointerLikeExists<xacc::Accelerator>("qpu")) {
+          qpu_name = options.getPointerLike<xacc::Accelerator>("qpu")->name();
+        } else if (options.pointerLikeExists<AcceleratorPool>("accelerator_pool")) {
+          qpu_name = options.getPointerLike<AcceleratorPool>("accelerator_pool")->name();
+        } else {
+          pool = std::make_shared<AcceleratorPool>(qpu_name, xacc::HeterogeneousMap{{"shots", 1}});
+          options.insert("accelerator_pool", pool.get());
+        }
+        auto initialize = [algorithm](const xacc::HeterogeneousMap &window_options) {
+          if (!algorithm->initialize(window_options)) {
+            throw std::runtime_error("Cannot decode the window!\n");
+          }
+        };
+
+        if (decoder == "simplified-decoder") {
+          // The beam's bit order, as the decoder reports it (see CtcReferenceDecoder)
+          const bool reversed_bit_order = qpu_name == "aer";
+          const bool is_msb = options.keyExists<bool>("is_msb") ? options.get<bool>("is_msb") : reversed_bit_order;
+          return [algorithm, pool, options, initialize, reversed_bit_order, is_msb](
+                     const std::vector<std::vector<float>> &window) {
+            const int nq_symbol = window_nq_symbol(window);
+            const int nb_qubits = window.size() * nq_symbol;
+            std::vector<int> qubits_string(nb_qubits);
+            std::iota(qubits_string.begin(), qubits_string.end(), 0);
+            if (options.keyExists<std::vector<int>>("qubits_string")) {
+              const auto &given = options.get<std::vector<int>>("qubits_string");
+              if ((int)given.size() < nb_qubits) {
+                throw std::runtime_error("qubits_string does not cover a window!\n");
+              }
+              qubits_string.assign(given.begin(), given.begin() + nb_qubits);
+            }
+            xacc::HeterogeneousMap window_options = options;
+            window_options.insert("probability_table", window);
+            window_options.insert("qubits_string", qubits_string);
+            initialize(window_options);
+            auto buffer = xacc::qalloc(nb_qubits);
+            algorithm->execute(buffer);
+            return feasible(window, beam_symbols(buffer->getInformation().at("best_beam").as<std::string>(),
+                                                 nq_symbol, is_msb, reversed_bit_order));
+          };
+        }
+        return [algorithm, pool, options, initialize](const std::vector<std::vector<float>> &window) {
+          const int nq_symbol = window_nq_symbol(window);
+          xacc::HeterogeneousMap window_options = options;
+          window_options.insert("probability_table", window);
+          initialize(window_options);
+          auto buffer = xacc::qalloc(1);
+          algorithm->execute(buffer);
+          auto info = buffer->getInformation();
+          const std::string best_string = info.at("best_string").as<std::string>();
+          if ((int)best_string.size() < (int)window.size() * nq_symbol) {
+            return CtcReference(window).best_path().symbols;
+          }
+          return feasible(window, compacted_beam(best_string, info.at("best_beam_length").as<int>(), nq_symbol));
+        };
+      }
+
+      WindowDecoder decode_;
+      WindowStitcher stitcher_;
+
+  };
+
+}
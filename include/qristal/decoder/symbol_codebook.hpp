@@ -0,0 +1,54 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "qristal/decoder/probability_table.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace qristal {
+
+  // Per-timestep symbol codebook
+
+  // Most timesteps of a probability table have only a few plausible symbols. The codebook keeps, for every
+  // timestep, its most probable symbols until they hold mass of the timestep's probability or number
+  // top_k (at least one), and numbers them by code: code k of a timestep is its k-th most probable symbol.
+  // The code table, with the kept probabilities renormalised and every row padded with zeros to the
+  // largest codebook, is encoded in place of the probability table, on nq_code qubits per timestep instead
+  // of enough for the whole alphabet. Measured codes are translated back to symbols before the beams are
+  // collapsed, so the beams are over the original alphabet. The probability of the symbols dropped,
+  // i.e. of a string with any of them, is discarded_probability. top_k <= 0 and mass >= 1 set no limit.
+
+  class SymbolCodebook {
+
+    public:
+
+      SymbolCodebook(const ProbabilityTable &probability_table, int top_k, double mass);
+
+      const std::vector<std::vector<float>> &code_table() const { return code_table_; }
+
+      // Per timestep, the symbol of every code of the code table, 0 (null) for the padding
+      const std::vector<std::vector<int>> &symbols() const { return symbols_; }
+
+      int nq_code() const { return nq_code_; }
+      double discarded_probability() const { return discarded_probability_; }
+
+      // Measured strings of codes, nq_code bits per timestep, as strings of nq_symbol-bit symbols in the same
+      // bit order (see DirectSampler), with the counts of strings translating alike summed. Bits past the
+      // string are dropped.
+      std::string translate(const std::string &bitstring, int nq_symbol, bool reversed_bit_order) const;
+      std::map<std::string, int> translate(const std::map<std::string, int> &measurements, int nq_symbol,
+                                           bool reversed_bit_order) const;
+
+    private:
+
+      std::vector<std::vector<float>> code_table_;
+      std::vector<std::vector<int>> symbols_;
+      int nq_code_ = 1;
+      double discarded_probability_ = 0.0;
+
+  };
+
+}
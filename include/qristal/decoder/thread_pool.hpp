@@ -0,0 +1,52 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace qristal {
+
+  // Fixed-size pool of worker threads for the classical stages of the decoders
+
+  class ThreadPool {
+
+    public:
+
+      explicit ThreadPool(std::size_t nb_threads);
+      ~ThreadPool();
+
+      ThreadPool(const ThreadPool &) = delete;
+      ThreadPool &operator=(const ThreadPool &) = delete;
+
+      // Queue a task to be run by one of the workers
+      void submit(std::function<void()> task);
+
+      // Run fn(i) for every i in [0, n) and wait for all of them to finish. The calling thread works
+      // through the indices too, so this makes progress (and cannot deadlock) even when every worker is
+      // busy, e.g. when called from inside another pool task. The first exception thrown is rethrown.
+      void parallel_for(std::size_t n, const std::function<void(std::size_t)> &fn);
+
+      std::size_t size() const { return workers_.size(); }
+
+    private:
+
+      void run();
+
+      std::vector<std::thread> workers_;
+      std::deque<std::function<void()>> tasks_;
+      std::mutex mutex_;
+      std::condition_variable wake_;
+      bool stop_ = false;
+
+  };
+
+  // Process-wide pool with one worker per hardware thread, less the calling thread
+  ThreadPool &default_thread_pool();
+
+}
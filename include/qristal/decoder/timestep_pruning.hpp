@@ -0,0 +1,42 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#pragma once
+
+#include "qristal/decoder/probability_table.hpp"
+
+#include <vector>
+
+namespace qristal {
+
+  // Timestep pruning
+
+  // Classical pre-pass shrinking a probability table (rows timesteps, column 0 the null symbol) before it
+  // is encoded, since every timestep costs the decoders a symbol register, a metric register, flags and its
+  // share of the kernel. Timesteps are taken as decided when their null probability exceeds
+  // blank_threshold, or when both they and the timestep kept before them have the same non-null most
+  // probable symbol with probability above repeat_threshold:
+  // - a run of decided nulls is dropped at the start or end of the table, and merged into a single,
+  //   certain null row elsewhere, which still separates the symbols either side; a lone one is kept as is.
+  // - a decided repeat is merged into the timestep before it.
+  // Every string of the pruned table stands for the string of the original table given by unprune_string,
+  // which collapses to the same beam, so beams decoded from the pruned table need no mapping back. The
+  // probability mass given up, that of any decided timestep going otherwise than decided, is reported as
+  // discarded_probability. Thresholds of 1 or more leave the table as is.
+
+  struct PrunedTable {
+    std::vector<std::vector<float>> probability_table;
+    std::vector<int> first_timestep;   // per row of the pruned table, the original timesteps it stands for
+    std::vector<int> last_timestep;
+    int nb_timesteps = 0;              // of the original table
+    int nb_blanks_pruned = 0;          // original timesteps dropped or merged as nulls
+    int nb_repeats_merged = 0;         // original timesteps merged into the one before
+    double discarded_probability = 0.0;
+  };
+
+  PrunedTable prune_timesteps(const ProbabilityTable &probability_table, double blank_threshold,
+                              double repeat_threshold);
+
+  // The original string (one symbol per original timestep) that a string of the pruned table stands for
+  std::vector<int> unprune_string(const PrunedTable &pruned, const std::vector<int> &string);
+
+}
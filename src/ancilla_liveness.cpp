@@ -0,0 +1,532 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/ancilla_liveness.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace qristal {
+
+  namespace {
+
+    /////////////////////////////////////////////////////////////////////////////////////////////
+    // Polynomials over GF(2)
+    /////////////////////////////////////////////////////////////////////////////////////////////
+
+    using Monomial = std::vector<int>;        // sorted variables; empty is the constant 1
+    using Polynomial = std::vector<Monomial>; // sorted, distinct monomials; empty is 0
+
+    // Polynomials are dropped for a fresh variable beyond this many terms, which only loses precision
+    constexpr std::size_t max_terms = 64;
+
+    // Keep the monomials that occur an odd number of times
+    Polynomial cancel(std::vector<Monomial> terms) {
+      std::sort(terms.begin(), terms.end());
+      Polynomial result;
+      for (std::size_t i = 0; i < terms.size();) {
+        std::size_t j = i;
+        while (j < terms.size() && terms[j] == terms[i]) {
+          j++;
+        }
+        if ((j - i) % 2) {
+          result.push_back(terms[i]);
+        }
+        i = j;
+      }
+      return result;
+    }
+
+    Polynomial add(const Polynomial &a, const Polynomial &b) {
+      Polynomial result;
+      std::set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+      return result;
+    }
+
+    std::optional<Polynomial> multiply(const Polynomial &a, const Polynomial &b) {
+      if (a.size() * b.size() > max_terms * max_terms) {
+        return std::nullopt;
+      }
+      std::vector<Monomial> terms;
+      terms.reserve(a.size() * b.size());
+      for (const Monomial &x : a) {
+        for (const Monomial &y : b) {
+          Monomial product;
+          std::set_union(x.begin(), x.end(), y.begin(), y.end(), std::back_inserter(product));
+          terms.push_back(std::move(product));
+        }
+      }
+      Polynomial result = cancel(std::move(terms));
+      if (result.size() > max_terms) {
+        return std::nullopt;
+      }
+      return result;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////
+    // Exact simulation of small windows
+    /////////////////////////////////////////////////////////////////////////////////////////////
+
+    using Amplitude = std::complex<double>;
+    using Matrix2 = std::array<Amplitude, 4>;  // row-major
+    using Matrix4 = std::array<Amplitude, 16>; // row-major, index 2*bit(qubits[0]) + bit(qubits[1])
+
+    // How a window acts on the computational basis
+    struct WindowEffect {
+      bool simulable = false;
+      bool permutation = false;
+      std::vector<int> image;      // output basis state per input basis state, for a permutation
+      std::vector<bool> preserved; // per local qubit: its basis value is never changed
+    };
+
+    std::optional<Matrix2> single_qubit_matrix(const std::string &name, const std::vector<double> &p) {
+      const Amplitude i(0.0, 1.0);
+      const double s = std::sqrt(0.5);
+      if (name == "I" || name == "Identity") return Matrix2{1, 0, 0, 1};
+      if (name == "X") return Matrix2{0, 1, 1, 0};
+      if (name == "Y") return Matrix2{0, -i, i, 0};
+      if (name == "Z") return Matrix2{1, 0, 0, -1};
+      if (name == "H") return Matrix2{s, s, s, -s};
+      if (name == "S") return Matrix2{1, 0, 0, i};
+      if (name == "Sdg") return Matrix2{1, 0, 0, -i};
+      if (name == "T") return Matrix2{1, 0, 0, std::exp(i * M_PI / 4.0)};
+      if (name == "Tdg") return Matrix2{1, 0, 0, std::exp(-i * M_PI / 4.0)};
+      if (p.size() == 1) {
+        const double c = std::cos(p[0] / 2), sn = std::sin(p[0] / 2);
+        if (name == "Rx") return Matrix2{c, -i * sn, -i * sn, c};
+        if (name == "Ry") return Matrix2{c, -sn, sn, c};
+        if (name == "Rz") return Matrix2{std::exp(-i * p[0] / 2.0), 0, 0, std::exp(i * p[0] / 2.0)};
+        if (name == "U1") return Matrix2{1, 0, 0, std::exp(i * p[0])};
+      }
+      if (name == "U" && p.size() == 3) {
+        const double c = std::cos(p[0] / 2), sn = std::sin(p[0] / 2);
+        return Matrix2{c, -std::exp(i * p[2]) * sn, std::exp(i * p[1]) * sn, std::exp(i * (p[1] + p[2])) * c};
+      }
+      return std::nullopt;
+    }
+
+    std::optional<Matrix4> two_qubit_matrix(const std::string &name, const std::vector<double> &p) {
+      const Amplitude i(0.0, 1.0);
+      Matrix4 m{};
+      auto controlled = [&](const Matrix2 &u) {
+        m[0] = m[5] = 1;
+        m[10] = u[0]; m[11] = u[1]; m[14] = u[2]; m[15] = u[3];
+        return m;
+      };
+      if (name == "CNOT" || name == "CX") return controlled(Matrix2{0, 1, 1, 0});
+      if (name == "CY") return controlled(Matrix2{0, -i, i, 0});
+      if (name == "CZ") return controlled(Matrix2{1, 0, 0, -1});
+      if (name == "CH") return controlled(*single_qubit_matrix("H", {}));
+      if (name == "CRZ" && p.size() == 1) return controlled(*single_qubit_matrix("Rz", p));
+      if (name == "CPhase" && p.size() == 1) return controlled(*single_qubit_matrix("U1", p));
+      if (name == "Swap") {
+        m[0] = m[6] = m[9] = m[15] = 1;
+        return m;
+      }
+      if (name == "iSwap") {
+        m[0] = m[15] = 1;
+        m[6] = m[9] = i;
+        return m;
+      }
+      return std::nullopt;
+    }
+
+    // A gate of a window, on local qubit indices
+    struct LocalGate {
+      const CircuitNode *gate;
+      std::vector<int> qubits;
+    };
+
+    std::optional<WindowEffect> simulate(const std::vector<LocalGate> &gates, int nb_qubits) {
+      const std::size_t dim = std::size_t(1) << nb_qubits;
+      WindowEffect effect;
+      effect.simulable = true;
+      effect.permutation = true;
+      effect.image.assign(dim, 0);
+      effect.preserved.assign(nb_qubits, true);
+
+      std::vector<Amplitude> state(dim);
+      for (std::size_t input = 0; input < dim; input++) {
+        std::fill(state.begin(), state.end(), 0.0);
+        state[input] = 1.0;
+        for (const LocalGate &local : gates) {
+          const CircuitNode &gate = *local.gate;
+          if (local.qubits.size() == 1) {
+            const auto u = single_qubit_matrix(gate.name, gate.parameters);
+            if (!u) return std::nullopt;
+            const std::size_t bit = std::size_t(1) << local.qubits[0];
+            for (std::size_t k = 0; k < dim; k++) {
+              if (k & bit) continue;
+              const Amplitude a = state[k], b = state[k | bit];
+              state[k] = (*u)[0] * a + (*u)[1] * b;
+              state[k | bit] = (*u)[2] * a + (*u)[3] * b;
+            }
+          } else if (local.qubits.size() == 2) {
+            const auto u = two_qubit_matrix(gate.name, gate.parameters);
+            if (!u) return std::nullopt;
+            const std::size_t bit0 = std::size_t(1) << local.qubits[0];
+            const std::size_t bit1 = std::size_t(1) << local.qubits[1];
+            for (std::size_t k = 0; k < dim; k++) {
+              if (k & (bit0 | bit1)) continue;
+              const std::size_t index[4] = {k, k | bit1, k | bit0, k | bit0 | bit1};
+              Amplitude in[4], out[4] = {};
+              for (int r = 0; r < 4; r++) in[r] = state[index[r]];
+              for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++) out[r] += (*u)[4 * r + c] * in[c];
+              }
+              for (int r = 0; r < 4; r++) state[index[r]] = out[r];
+            }
+          } else {
+            return std::nullopt;
+          }
+        }
+
+        int nb_outputs = 0;
+        for (std::size_t output = 0; output < dim; output++) {
+          if (std::abs(state[output]) < 1e-9) continue;
+          nb_outputs++;
+          effect.image[input] = output;
+          for (int q = 0; q < nb_qubits; q++) {
+            if (((output ^ input) >> q) & 1) {
+              effect.preserved[q] = false;
+            }
+          }
+        }
+        if (nb_outputs != 1) {
+          effect.permutation = false;
+        }
+      }
+      return effect;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////////////////
+    // Liveness
+    /////////////////////////////////////////////////////////////////////////////////////////////
+
+    // A step of the analysis: a gate, or a window simulated as a whole
+    struct Unit {
+      const CircuitNode *node;
+      std::vector<int> qubits; // every qubit the unit acts on, distinct
+    };
+
+    // Gates that permute basis states or are diagonal, which are tracked exactly gate by gate
+    bool is_classical(const CircuitNode &gate) {
+      static const std::set<std::string> names = {"I", "Identity", "X", "Y", "Z", "S", "Sdg", "T", "Tdg", "Rz",
+                                                  "U1", "CNOT", "CX", "CY", "CZ", "CRZ", "CPhase", "Swap",
+                                                  "Measure"};
+      return names.count(gate.name) > 0;
+    }
+
+    void collect_gates(const CircuitNode &node, std::vector<const CircuitNode *> &gates) {
+      if (node.composite) {
+        for (const CircuitNode &child : node.children) {
+          collect_gates(child, gates);
+        }
+      } else {
+        gates.push_back(&node);
+      }
+    }
+
+    class LivenessAnalysis {
+
+      public:
+
+        explicit LivenessAnalysis(const std::set<int> &ancillas) : ancillas_(ancillas) {}
+
+        // Split a circuit into units, tracking every qubit's value through them
+        void run(const CircuitNode &node) {
+          if (!node.composite) {
+            apply(Unit{&node, distinct(node.qubits)});
+            return;
+          }
+          // A composite of gates only is taken whole if it is a permutation that gate by gate would not be
+          // tracked exactly, e.g. a decomposed Toffoli. Otherwise its parts are analysed one by one, which
+          // gives finer live ranges.
+          std::set<int> qubits;
+          bool gates_only = !node.children.empty();
+          bool classical = true;
+          for (const CircuitNode &child : node.children) {
+            gates_only = gates_only && !child.composite;
+            classical = classical && !child.composite && is_classical(child);
+            qubits.insert(child.qubits.begin(), child.qubits.end());
+          }
+          if (gates_only && !classical && qubits.size() <= max_window_qubits) {
+            const Unit window{&node, std::vector<int>(qubits.begin(), qubits.end())};
+            if (effect(window).permutation) {
+              apply(window);
+              return;
+            }
+          }
+          for (const CircuitNode &child : node.children) {
+            run(child);
+          }
+        }
+
+        const std::vector<Unit> &units() const { return units_; }
+
+        // Ancillas provably in |0> after each unit, of those the unit acts on
+        const std::vector<std::vector<int>> &clean_after() const { return clean_after_; }
+
+      private:
+
+        static std::vector<int> distinct(std::vector<int> qubits) {
+          std::sort(qubits.begin(), qubits.end());
+          qubits.erase(std::unique(qubits.begin(), qubits.end()), qubits.end());
+          return qubits;
+        }
+
+        Polynomial &value(int qubit) {
+          auto iter = values_.find(qubit);
+          if (iter == values_.end()) {
+            iter = values_.emplace(qubit, ancillas_.count(qubit) ? Polynomial{} : fresh()).first;
+          }
+          return iter->second;
+        }
+
+        Polynomial fresh() { return Polynomial{Monomial{next_variable_++}}; }
+
+        const WindowEffect &effect(const Unit &unit) {
+          std::vector<const CircuitNode *> gates;
+          collect_gates(*unit.node, gates);
+          std::vector<LocalGate> local_gates;
+          std::ostringstream key;
+          key.precision(17);
+          for (const CircuitNode *gate : gates) {
+            LocalGate local{gate, {}};
+            key << gate->name;
+            for (int qubit : gate->qubits) {
+              local.qubits.push_back(std::lower_bound(unit.qubits.begin(), unit.qubits.end(), qubit) - unit.qubits.begin());
+              key << ' ' << local.qubits.back();
+            }
+            for (double parameter : gate->parameters) {
+              key << ' ' << parameter;
+            }
+            key << ';';
+            local_gates.push_back(std::move(local));
+          }
+          auto iter = effects_.find(key.str());
+          if (iter == effects_.end()) {
+            WindowEffect window;
+            if (auto simulated = simulate(local_gates, unit.qubits.size())) {
+              window = std::move(*simulated);
+            }
+            iter = effects_.emplace(key.str(), std::move(window)).first;
+          }
+          return iter->second;
+        }
+
+        void apply(const Unit &unit) {
+          const CircuitNode &node = *unit.node;
+          if (!node.composite && node.name == "Reset") {
+            value(node.qubits[0]).clear();
+          } else if (!node.composite && node.name == "Measure") {
+            // A measurement leaves every basis value as it was
+          } else if (unit.qubits.size() > max_window_qubits) {
+            for (int qubit : unit.qubits) {
+              value(qubit) = fresh();
+            }
+          } else {
+            apply_window(unit);
+          }
+
+          std::vector<int> clean;
+          for (int qubit : unit.qubits) {
+            if (ancillas_.count(qubit) && value(qubit).empty()) {
+              clean.push_back(qubit);
+            }
+          }
+          units_.push_back(unit);
+          clean_after_.push_back(std::move(clean));
+        }
+
+        void apply_window(const Unit &unit) {
+          const WindowEffect &window = effect(unit);
+          const int k = unit.qubits.size();
+          if (!window.simulable) {
+            for (int qubit : unit.qubits) {
+              value(qubit) = fresh();
+            }
+            return;
+          }
+          if (!window.permutation) {
+            for (int q = 0; q < k; q++) {
+              if (!window.preserved[q]) {
+                value(unit.qubits[q]) = fresh();
+              }
+            }
+            return;
+          }
+
+          std::vector<Polynomial> inputs;
+          for (int qubit : unit.qubits) {
+            inputs.push_back(value(qubit));
+          }
+          const std::size_t dim = std::size_t(1) << k;
+          for (int q = 0; q < k; q++) {
+            if (window.preserved[q]) {
+              continue;
+            }
+            // Algebraic normal form of output bit q, by the Moebius transform of its truth table
+            std::vector<char> anf(dim);
+            for (std::size_t x = 0; x < dim; x++) {
+              anf[x] = (window.image[x] >> q) & 1;
+            }
+            for (int bit = 0; bit < k; bit++) {
+              for (std::size_t x = 0; x < dim; x++) {
+                if ((x >> bit) & 1) {
+                  anf[x] ^= anf[x ^ (std::size_t(1) << bit)];
+                }
+              }
+            }
+            // Substitute the input values
+            std::optional<Polynomial> output = Polynomial{};
+            for (std::size_t x = 0; x < dim && output; x++) {
+              if (!anf[x]) {
+                continue;
+              }
+              std::optional<Polynomial> term = Polynomial{Monomial{}};
+              for (int bit = 0; bit < k && term; bit++) {
+                if ((x >> bit) & 1) {
+                  term = multiply(*term, inputs[bit]);
+                }
+              }
+              if (term) {
+                output = add(*output, *term);
+                if (output->size() > max_terms) {
+                  output.reset();
+                }
+              } else {
+                output.reset();
+              }
+            }
+            value(unit.qubits[q]) = output ? std::move(*output) : fresh();
+          }
+        }
+
+        const std::set<int> &ancillas_;
+        std::unordered_map<int, Polynomial> values_;
+        std::unordered_map<std::string, WindowEffect> effects_;
+        std::vector<Unit> units_;
+        std::vector<std::vector<int>> clean_after_;
+        int next_variable_ = 0;
+    };
+
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  AncillaReuse reuse_ancillas(const CircuitNode &circuit, const std::vector<int> &ancilla_pool,
+                              const std::vector<int> &reserved) {
+    const std::set<int> ancillas(ancilla_pool.begin(), ancilla_pool.end());
+    LivenessAnalysis analysis(ancillas);
+    analysis.run(circuit);
+    const std::vector<Unit> &units = analysis.units();
+    const int nb_units = units.size();
+
+    // Live ranges of every ancilla, in units: from the unit that finds it in |0> to the unit that returns it
+    struct Range {
+      int qubit, begin, end;
+      bool open; // not provably |0> at the end of the circuit
+    };
+    std::vector<Range> ranges;
+    std::map<int, int> open_range; // ancilla -> index of its open range
+    for (int u = 0; u < nb_units; u++) {
+      const std::vector<int> &clean = analysis.clean_after()[u];
+      for (int qubit : units[u].qubits) {
+        if (!ancillas.count(qubit)) {
+          continue;
+        }
+        auto iter = open_range.find(qubit);
+        if (iter == open_range.end()) {
+          iter = open_range.emplace(qubit, (int)ranges.size()).first;
+          ranges.push_back({qubit, u, u, true});
+        }
+        ranges[iter->second].end = u;
+        if (std::binary_search(clean.begin(), clean.end(), qubit)) {
+          ranges[iter->second].open = false;
+          open_range.erase(iter);
+        }
+      }
+    }
+    for (const auto &[qubit, index] : open_range) {
+      ranges[index].end = nb_units;
+    }
+
+    // Pack the ranges onto the pool in order of their start, each on the first pool qubit free by then.
+    // A range still live at the end must not take a reserved qubit.
+    const std::set<int> reserved_set(reserved.begin(), reserved.end());
+    std::vector<int> busy_until(ancilla_pool.size(), -1);
+    std::vector<int> assigned(ranges.size());
+    std::vector<int> order(ranges.size());
+    for (std::size_t r = 0; r < ranges.size(); r++) {
+      order[r] = r;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return ranges[a].begin < ranges[b].begin; });
+    bool packed = true;
+    for (int r : order) {
+      std::size_t p = 0;
+      while (p < ancilla_pool.size() &&
+             (busy_until[p] >= ranges[r].begin || (ranges[r].open && reserved_set.count(ancilla_pool[p])))) {
+        p++;
+      }
+      if (p == ancilla_pool.size()) {
+        packed = false;
+        break;
+      }
+      busy_until[p] = ranges[r].end;
+      assigned[r] = p;
+    }
+    // Only if the circuit itself leaves a reserved qubit dirty: keep every ancilla where it was
+    if (!packed) {
+      for (std::size_t r = 0; r < ranges.size(); r++) {
+        assigned[r] = std::find(ancilla_pool.begin(), ancilla_pool.end(), ranges[r].qubit) - ancilla_pool.begin();
+      }
+    }
+
+    // Rewrite every unit with the pool qubits of the ranges covering it
+    AncillaReuse reuse;
+    std::vector<std::map<int, int>> unit_maps(nb_units);
+    for (std::size_t r = 0; r < ranges.size(); r++) {
+      for (int u = ranges[r].begin; u <= std::min(ranges[r].end, nb_units - 1); u++) {
+        unit_maps[u][ranges[r].qubit] = ancilla_pool[assigned[r]];
+      }
+    }
+    for (int u = 0; u < nb_units; u++) {
+      std::vector<const CircuitNode *> gates;
+      collect_gates(*units[u].node, gates);
+      for (const CircuitNode *gate : gates) {
+        RemappedGate remapped{gate->id, gate->qubits};
+        for (int &qubit : remapped.qubits) {
+          auto iter = unit_maps[u].find(qubit);
+          if (iter != unit_maps[u].end()) {
+            qubit = iter->second;
+          }
+        }
+        reuse.gates.push_back(std::move(remapped));
+      }
+    }
+
+    std::set<int> used, dirty;
+    for (std::size_t r = 0; r < ranges.size(); r++) {
+      used.insert(assigned[r]);
+      if (ranges[r].open) {
+        dirty.insert(assigned[r]);
+      }
+    }
+    for (int p : used) {
+      reuse.ancillas_used.push_back(ancilla_pool[p]);
+    }
+    for (int p : dirty) {
+      reuse.dirty_ancillas.push_back(ancilla_pool[p]);
+    }
+    return reuse;
+  }
+
+}
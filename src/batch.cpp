@@ -0,0 +1,22 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/batch.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+namespace qristal {
+
+  std::vector<std::size_t> batch_order(const std::vector<std::vector<std::vector<float>>> &probability_tables) {
+    auto shape = [&](std::size_t i) {
+      const auto &table = probability_tables[i];
+      return std::make_pair(table.size(), table.empty() ? std::size_t(0) : table[0].size());
+    };
+    std::vector<std::size_t> order(probability_tables.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return shape(a) < shape(b); });
+    return order;
+  }
+
+}
@@ -0,0 +1,152 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/beam_aggregation.hpp"
+#include "qristal/decoder/thread_pool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <memory>
+
+namespace qristal {
+
+  BeamCountTable::BeamCountTable(std::size_t expected_size) {
+    // Keep the load factor at or below one half
+    const std::size_t capacity = std::bit_ceil(std::max<std::size_t>(16, 2 * expected_size));
+    slots_.resize(capacity);
+    mask_ = capacity - 1;
+  }
+
+  void BeamCountTable::add(const PackedBeam &beam, std::size_t hash, int count) {
+    if (count <= 0) {
+      return;
+    }
+    std::size_t index = hash & mask_;
+    while (slots_[index].count > 0) {
+      Slot &slot = slots_[index];
+      if (slot.hash == hash && slot.beam == beam) {
+        slot.count += count;
+        return;
+      }
+      index = (index + 1) & mask_;
+    }
+    slots_[index].hash = hash;
+    slots_[index].count = count;
+    slots_[index].beam = beam;
+    if (2 * ++size_ > slots_.size()) {
+      grow();
+    }
+  }
+
+  void BeamCountTable::grow() {
+    std::vector<Slot> old_slots(2 * slots_.size());
+    old_slots.swap(slots_);
+    mask_ = slots_.size() - 1;
+    for (auto &slot : old_slots) {
+      if (slot.count > 0) {
+        std::size_t index = slot.hash & mask_;
+        while (slots_[index].count > 0) {
+          index = (index + 1) & mask_;
+        }
+        slots_[index] = std::move(slot);
+      }
+    }
+  }
+
+  void BeamCountTable::merge(const BeamCountTable &other) {
+    for (const auto &slot : other.slots_) {
+      if (slot.count > 0) {
+        add(slot.beam, slot.hash, slot.count);
+      }
+    }
+  }
+
+  std::vector<std::pair<PackedBeam, int>> BeamCountTable::sorted() const {
+    std::vector<std::pair<PackedBeam, int>> beams;
+    beams.reserve(size_);
+    for_each([&](const PackedBeam &beam, int count) { beams.emplace_back(beam, count); });
+    std::sort(beams.begin(), beams.end(),
+              [](const auto &x, const auto &y) { return x.first < y.first; });
+    return beams;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<std::pair<PackedBeam, int>> aggregate_sharded(
+      std::size_t n, int nb_threads, std::size_t min_items_per_shard,
+      const std::function<void(std::size_t, std::size_t, PartitionedBeamCounts &)> &produce) {
+
+    ThreadPool &pool = default_thread_pool();
+    std::size_t nb_shards = nb_threads > 0 ? nb_threads : pool.size() + 1;
+    nb_shards = std::max<std::size_t>(1, std::min(nb_shards, n / std::max<std::size_t>(1, min_items_per_shard)));
+
+    if (nb_shards == 1) {
+      PartitionedBeamCounts counts(1, n);
+      produce(0, n, counts);
+      return counts.partition(0).sorted();
+    }
+
+    // Map: each shard fills its own partitioned tables
+    const std::size_t nb_partitions = nb_shards;
+    std::vector<std::unique_ptr<PartitionedBeamCounts>> partial(nb_shards);
+    pool.parallel_for(nb_shards, [&](std::size_t shard) {
+      const std::size_t begin = n * shard / nb_shards;
+      const std::size_t end = n * (shard + 1) / nb_shards;
+      partial[shard] = std::make_unique<PartitionedBeamCounts>(nb_partitions, end - begin);
+      produce(begin, end, *partial[shard]);
+    });
+
+    // Reduce: every partition is merged independently of the others
+    std::vector<std::vector<std::pair<PackedBeam, int>>> reduced(nb_partitions);
+    pool.parallel_for(nb_partitions, [&](std::size_t partition) {
+      BeamCountTable table(partial[0]->partition(partition).size());
+      for (std::size_t shard = 0; shard < nb_shards; shard++) {
+        table.merge(partial[shard]->partition(partition));
+      }
+      reduced[partition] = table.sorted();
+    });
+
+    // Partitions hold disjoint sets of beams, so merging the sorted partitions gives the final order
+    std::vector<std::pair<PackedBeam, int>> beams;
+    for (auto &partition : reduced) {
+      const std::size_t middle = beams.size();
+      beams.insert(beams.end(), std::make_move_iterator(partition.begin()),
+                   std::make_move_iterator(partition.end()));
+      std::inplace_merge(beams.begin(), beams.begin() + middle, beams.end(),
+                         [](const auto &x, const auto &y) { return x.first < y.first; });
+    }
+    return beams;
+  }
+
+  std::vector<std::pair<PackedBeam, int>> aggregate_beams(const std::map<std::string, int> &measurements,
+                                                          const BeamCollapser &collapser,
+                                                          int nb_threads) {
+    // Random access to the outcomes for sharding
+    std::vector<const std::pair<const std::string, int> *> outcomes;
+    outcomes.reserve(measurements.size());
+    for (const auto &outcome : measurements) {
+      outcomes.push_back(&outcome);
+    }
+
+    // Below this many outcomes per shard, threading costs more than it saves
+    const std::size_t min_outcomes_per_shard = 2048;
+    return aggregate_sharded(outcomes.size(), nb_threads, min_outcomes_per_shard,
+        [&](std::size_t begin, std::size_t end, PartitionedBeamCounts &counts) {
+          PackedBeam beam;
+          for (std::size_t i = begin; i < end; i++) {
+            collapser.collapse(outcomes[i]->first, beam);
+            counts.add(beam, outcomes[i]->second);
+          }
+        });
+  }
+
+  double leader_confidence(int leader, int runner_up) {
+    const int total = leader + runner_up;
+    if (total == 0) {
+      return 0.5;
+    }
+    const double z = (leader - runner_up)/std::sqrt(double(total));
+    return 0.5*std::erfc(-z/std::sqrt(2.0));
+  }
+
+}
@@ -0,0 +1,218 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/beam_collapse.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace qristal {
+
+  namespace {
+
+    // Lowest bit of every w-bit field in a 64-bit word
+    constexpr std::uint64_t field_low_bits(int w) {
+      std::uint64_t bits = 0;
+      for (int k = 0; k < 64 / w; k++) {
+        bits |= std::uint64_t(1) << (k * w);
+      }
+      return bits;
+    }
+
+    // Parse n <= 64 characters of '0'/'1' as a binary number, most significant bit first
+    std::uint64_t parse_binary(const char *chars, int n) {
+      std::uint64_t value = 0;
+      int i = 0;
+      if constexpr (std::endian::native == std::endian::little) {
+        // Eight characters at a time: keep bit 0 of each byte (set for '1', clear for '0') and gather
+        // the eight bits into the top byte with a single multiply. No two partial products share a bit
+        // position, so there are no carries into the result byte.
+        for (; i + 8 <= n; i += 8) {
+          std::uint64_t chunk;
+          std::memcpy(&chunk, chars + i, sizeof(chunk));
+          value = (value << 8) | (((chunk & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56);
+        }
+      }
+      for (; i < n; i++) {
+        value = (value << 1) | (chars[i] & 1);
+      }
+      return value;
+    }
+
+  }
+
+  std::size_t PackedBeamHash::operator()(const PackedBeam &beam) const {
+    std::uint64_t h = beam.words.size();
+    for (std::uint64_t word : beam.words) {
+      // splitmix64 finaliser
+      std::uint64_t z = word + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      h ^= z ^ (z >> 31);
+    }
+    return static_cast<std::size_t>(h);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  BeamCollapser::BeamCollapser(int nb_timesteps, int nq_symbol, bool is_msb)
+      : nb_timesteps_(nb_timesteps), nq_symbol_(nq_symbol), is_msb_(is_msb) {
+    if (nq_symbol < 1 || nq_symbol > 32) {
+      throw std::runtime_error("Invalid number of nq_symbol!\n");
+    }
+    if (nb_timesteps < 0) {
+      throw std::runtime_error("Invalid number of timesteps!\n");
+    }
+    symbols_per_word_ = 64 / nq_symbol_;
+    nb_words_ = (nb_timesteps_ + symbols_per_word_ - 1) / symbols_per_word_;
+    field_mask_ = (std::uint64_t(1) << nq_symbol_) - 1;
+    low_bits_ = field_low_bits(nq_symbol_);
+    high_bits_ = low_bits_ << (nq_symbol_ - 1);
+
+    switch (nq_symbol_) {
+      case 1: collapse_fn_ = &collapse_words<1>; break;
+      case 2: collapse_fn_ = &collapse_words<2>; break;
+      case 3: collapse_fn_ = &collapse_words<3>; break;
+      case 4: collapse_fn_ = &collapse_words<4>; break;
+      case 5: collapse_fn_ = &collapse_words<5>; break;
+      case 6: collapse_fn_ = &collapse_words<6>; break;
+      case 7: collapse_fn_ = &collapse_words<7>; break;
+      case 8: collapse_fn_ = &collapse_words<8>; break;
+      case 10: collapse_fn_ = &collapse_words<10>; break;
+      case 12: collapse_fn_ = &collapse_words<12>; break;
+      case 16: collapse_fn_ = &collapse_words<16>; break;
+      default: collapse_fn_ = &collapse_words<0>; break;
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  void BeamCollapser::pack(const std::string &bitstring, std::vector<std::uint64_t> &words) const {
+    const int bits_per_word = symbols_per_word_ * nq_symbol_;
+    int remaining = nb_timesteps_ * nq_symbol_;
+    if ((int)bitstring.size() < remaining) {
+      throw std::runtime_error("Measured bitstring is shorter than nb_timesteps*nq_symbol!\n");
+    }
+    words.resize(nb_words_);
+    const char *chars = bitstring.data();
+    for (int i = 0; i < nb_words_; i++) {
+      const int n = std::min(bits_per_word, remaining);
+      // A short final word is shifted up so that its first symbol still sits in the top field
+      words[i] = parse_binary(chars, n) << (bits_per_word - n);
+      chars += n;
+      remaining -= n;
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  template <int W>
+  void BeamCollapser::collapse_words(const BeamCollapser &collapser, const std::uint64_t *words, PackedBeam &beam) {
+    // With W fixed, the width, field layout and masks below are all compile-time constants
+    const int w = W > 0 ? W : collapser.nq_symbol_;
+    const int spw = W > 0 ? 64 / W : collapser.symbols_per_word_;
+    const std::uint64_t field_mask = W > 0 ? (std::uint64_t(1) << W) - 1 : collapser.field_mask_;
+    const std::uint64_t low_bits = W > 0 ? field_low_bits(W) : collapser.low_bits_;
+    const std::uint64_t high_bits = low_bits << (w - 1);
+    const int top_shift = (spw - 1) * w;
+    const std::uint64_t top_high = std::uint64_t(1) << (top_shift + w - 1);
+    const std::uint64_t inner_bits = high_bits - low_bits; // all but the highest bit of every field
+    const int nb_words = collapser.nb_words_;
+
+    // High bit of every field that is zero, all other bits clear. (x & inner) + inner sets the high bit
+    // of a field iff any lower bit is set, and cannot carry into the next field.
+    auto zero_fields = [&](std::uint64_t x) {
+      return ~(((x & inner_bits) + inner_bits) | x | inner_bits) & high_bits;
+    };
+
+    beam.words.assign(nb_words, 0);
+    int length = 0;
+    int out_index = 0;
+    int out_shift = top_shift;
+
+    std::uint64_t previous = 0; // last symbol of the previous word
+    int remaining = collapser.nb_timesteps_;
+    for (int i = 0; i < nb_words; i++) {
+      const std::uint64_t word = words[i];
+      const int nb_fields = std::min(spw, remaining);
+      remaining -= nb_fields;
+      const int unused_shift = (spw - nb_fields) * w;
+
+      // Align every symbol with its predecessor and flag repeats and nulls
+      const std::uint64_t valid = high_bits & ~((std::uint64_t(1) << unused_shift) - 1);
+      const std::uint64_t aligned_previous = (word >> w) | (previous << top_shift);
+      std::uint64_t repeats = zero_fields(word ^ aligned_previous);
+      if (i == 0) {
+        repeats &= ~top_high; // the first symbol has no predecessor
+      }
+      std::uint64_t keep = valid & ~zero_fields(word) & ~repeats;
+
+      // Append the surviving symbols in order
+      while (keep) {
+        const int bit = 63 - std::countl_zero(keep);
+        const std::uint64_t symbol = (word >> (bit - w + 1)) & field_mask;
+        beam.words[out_index] |= symbol << out_shift;
+        length++;
+        if (out_shift == 0) {
+          out_index++;
+          out_shift = top_shift;
+        } else {
+          out_shift -= w;
+        }
+        keep ^= std::uint64_t(1) << bit;
+      }
+
+      previous = (word >> unused_shift) & field_mask;
+    }
+
+    beam.words.resize((length + spw - 1) / spw);
+    beam.length = length;
+
+    // msb-ordered accelerators report the beam with its symbols reversed
+    if (collapser.is_msb_) {
+      auto shift_of = [&](int k) { return (spw - 1 - k % spw) * w; };
+      for (int a = 0, b = length - 1; a < b; a++, b--) {
+        std::uint64_t &word_a = beam.words[a / spw];
+        std::uint64_t &word_b = beam.words[b / spw];
+        const std::uint64_t symbol_a = (word_a >> shift_of(a)) & field_mask;
+        const std::uint64_t symbol_b = (word_b >> shift_of(b)) & field_mask;
+        word_a = (word_a & ~(field_mask << shift_of(a))) | (symbol_b << shift_of(a));
+        word_b = (word_b & ~(field_mask << shift_of(b))) | (symbol_a << shift_of(b));
+      }
+    }
+  }
+
+  void BeamCollapser::collapse_packed(const std::uint64_t *words, PackedBeam &beam) const {
+    collapse_fn_(*this, words, beam);
+  }
+
+  void BeamCollapser::collapse(const std::string &bitstring, PackedBeam &beam) const {
+    thread_local std::vector<std::uint64_t> words;
+    pack(bitstring, words);
+    collapse_packed(words.data(), beam);
+  }
+
+  PackedBeam BeamCollapser::collapse(const std::string &bitstring) const {
+    PackedBeam beam;
+    collapse(bitstring, beam);
+    return beam;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string BeamCollapser::to_string(const PackedBeam &beam) const {
+    const int w = nq_symbol_;
+    const int spw = symbols_per_word_;
+    std::string bitstring;
+    bitstring.reserve(beam.length * w);
+    for (int k = 0; k < beam.length; k++) {
+      const std::uint64_t symbol = (beam.words[k / spw] >> ((spw - 1 - k % spw) * w)) & field_mask_;
+      for (int bit = w - 1; bit >= 0; bit--) {
+        bitstring.push_back((symbol >> bit) & 1 ? '1' : '0');
+      }
+    }
+    return bitstring;
+  }
+
+}
@@ -0,0 +1,82 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/bounded_executor.hpp"
+
+#include <algorithm>
+
+namespace qristal {
+
+  BoundedExecutor::BoundedExecutor(std::size_t nb_workers, std::size_t max_pending)
+      : max_pending_(std::max<std::size_t>(1, max_pending)) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(1, nb_workers); i++) {
+      workers_.emplace_back([this] { run(); });
+    }
+  }
+
+  BoundedExecutor::~BoundedExecutor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) {
+      worker.join();
+    }
+  }
+
+  void BoundedExecutor::run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return; // stopping and drained
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+        running_++;
+      }
+      task();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_--;
+      }
+      room_.notify_all();
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  void BoundedExecutor::submit(std::function<void()> task) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      room_.wait(lock, [this] { return tasks_.size() + running_ < max_pending_; });
+      tasks_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+  }
+
+  bool BoundedExecutor::try_submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (tasks_.size() + running_ >= max_pending_) {
+        return false;
+      }
+      tasks_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+    return true;
+  }
+
+  void BoundedExecutor::wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    room_.wait(lock, [this] { return tasks_.empty() && running_ == 0; });
+  }
+
+  std::size_t BoundedExecutor::pending() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.size() + running_;
+  }
+
+}
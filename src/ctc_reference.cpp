@@ -0,0 +1,254 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/ctc_reference.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace qristal {
+
+  double log_sum_exp(double a, double b) {
+    if (a <= log_zero || b <= log_zero) {
+      return std::max(a, b);
+    }
+    const double m = std::max(a, b);
+    return m + std::log(std::exp(a - m) + std::exp(b - m));
+  }
+
+  CtcReference::CtcReference(const ProbabilityTable &probability_table)
+      : nb_timesteps_(probability_table.size()),
+        nb_symbols_(probability_table.nb_symbols()) {
+    if (nb_timesteps_ == 0 || nb_symbols_ < 2) {
+      throw std::runtime_error("Probability table needs at least one timestep and two symbols!\n");
+    }
+    log_table_.reserve(nb_timesteps_ * nb_symbols_);
+    // Rows of a ProbabilityTable all have the same length
+    const float *p = probability_table.data();
+    for (int i = 0; i < nb_timesteps_ * nb_symbols_; i++) {
+      log_table_.push_back(p[i] > 0.0f ? std::max(std::log(double(p[i])), log_zero) : log_zero);
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  double CtcReference::log_probability(const std::vector<int> &beam) const {
+    // Null-interleaved labels: - b0 - b1 - ... - b(n-1) -
+    const int nb_labels = 2 * beam.size() + 1;
+    std::vector<int> labels(nb_labels, 0);
+    std::vector<double> skip(nb_labels, log_zero); // 0 where a path may jump over the null before a label
+    for (std::size_t i = 0; i < beam.size(); i++) {
+      if (beam[i] <= 0 || beam[i] >= nb_symbols_) {
+        throw std::runtime_error("Beam symbols must be non-null symbols of the probability table!\n");
+      }
+      labels[2 * i + 1] = beam[i];
+      // The first label may be reached straight from the start, skipping the leading null
+      if (i == 0 || beam[i] != beam[i - 1]) {
+        skip[2 * i + 1] = 0.0;
+      }
+    }
+
+    // alpha[s + 2] is the log probability of all paths up to the current timestep ending in label s;
+    // the two leading entries stay at log_zero so that the recurrence needs no bounds checks. Before the
+    // first timestep, all probability sits on a virtual label preceding the first null.
+    std::vector<double> alpha(nb_labels + 2, log_zero), next(nb_labels + 2, log_zero), emit(nb_labels);
+    alpha[1] = 0.0;
+    for (int t = 0; t < nb_timesteps_; t++) {
+      const double *row = &log_table_[t * nb_symbols_];
+      for (int s = 0; s < nb_labels; s++) {
+        emit[s] = row[labels[s]];
+      }
+      // Branch-free three-way log-sum-exp over contiguous arrays
+      for (int s = 0; s < nb_labels; s++) {
+        const double stay = alpha[s + 2];
+        const double advance = alpha[s + 1];
+        const double jump = alpha[s] + skip[s];
+        const double m = std::max(stay, std::max(advance, jump));
+        next[s + 2] = m + std::log(std::exp(stay - m) + std::exp(advance - m) + std::exp(jump - m)) + emit[s];
+      }
+      std::swap(alpha, next);
+      alpha[1] = log_zero;
+    }
+
+    // Paths end on the last label or the trailing null
+    const double result = nb_labels > 1 ? log_sum_exp(alpha[nb_labels + 1], alpha[nb_labels]) : alpha[nb_labels + 1];
+    return std::max(result, log_zero);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  ScoredBeam CtcReference::best_path() const {
+    ScoredBeam beam;
+    int previous = 0;
+    for (int t = 0; t < nb_timesteps_; t++) {
+      const double *row = &log_table_[t * nb_symbols_];
+      const int symbol = std::max_element(row, row + nb_symbols_) - row;
+      if (symbol != 0 && symbol != previous) {
+        beam.symbols.push_back(symbol);
+      }
+      previous = symbol;
+    }
+    beam.log_probability = log_probability(beam.symbols);
+    return beam;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<int> CtcReference::align(const std::vector<int> &beam) const {
+    // Viterbi over the same null-interleaved labels as log_probability, keeping the best predecessor
+    const int nb_labels = 2 * beam.size() + 1;
+    std::vector<int> labels(nb_labels, 0);
+    std::vector<bool> can_jump(nb_labels, false);
+    for (std::size_t i = 0; i < beam.size(); i++) {
+      if (beam[i] <= 0 || beam[i] >= nb_symbols_) {
+        throw std::runtime_error("Beam symbols must be non-null symbols of the probability table!\n");
+      }
+      labels[2 * i + 1] = beam[i];
+      can_jump[2 * i + 1] = i == 0 || beam[i] != beam[i - 1];
+    }
+
+    // delta[s + 1] is the best log probability of a path up to the current timestep ending in label s,
+    // with delta[0] the virtual label preceding the first null; from[t][s] is that path's label at t - 1
+    std::vector<double> delta(nb_labels + 1, log_zero), next(nb_labels + 1, log_zero);
+    std::vector<std::vector<int>> from(nb_timesteps_, std::vector<int>(nb_labels, -1));
+    delta[0] = 0.0;
+    for (int t = 0; t < nb_timesteps_; t++) {
+      const double *row = &log_table_[t * nb_symbols_];
+      for (int s = 0; s < nb_labels; s++) {
+        int best = s;
+        if (delta[s] > delta[best + 1]) {
+          best = s - 1;
+        }
+        if (s >= 1 && can_jump[s] && delta[s - 1] > delta[best + 1]) {
+          best = s - 2;
+        }
+        next[s + 1] = delta[best + 1] + row[labels[s]];
+        from[t][s] = best;
+      }
+      std::swap(delta, next);
+      delta[0] = log_zero;
+    }
+
+    // Paths end on the last label or the trailing null
+    int s = nb_labels - 1;
+    if (nb_labels > 1 && delta[nb_labels - 1] > delta[nb_labels]) {
+      s = nb_labels - 2;
+    }
+    if (delta[s + 1] <= log_zero / 2) {
+      throw std::runtime_error("Beam cannot be aligned with the probability table!\n");
+    }
+    std::vector<int> alignment(nb_timesteps_);
+    for (int t = nb_timesteps_ - 1; t >= 0; t--) {
+      alignment[t] = labels[s];
+      s = from[t][s];
+    }
+    return alignment;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<ScoredBeam> CtcReference::top_beams(int top_k, int beam_width) const {
+    beam_width = std::max(beam_width, top_k);
+
+    // Prefix trie: every prefix is a node holding its last symbol and its parent
+    struct Node {
+      int parent;
+      int symbol; // 0 for the empty prefix
+    };
+    std::vector<Node> nodes = {{-1, 0}};
+    std::unordered_map<std::uint64_t, int> children;
+    auto child = [&](int node, int symbol) {
+      const std::uint64_t key = (std::uint64_t(node) << 32) | std::uint32_t(symbol);
+      auto [iter, inserted] = children.try_emplace(key, (int)nodes.size());
+      if (inserted) {
+        nodes.push_back({node, symbol});
+      }
+      return iter->second;
+    };
+
+    // Log probabilities of the paths collapsing to each prefix, split by whether they end in a null
+    struct Prefix {
+      int node;
+      double null_ending;
+      double symbol_ending;
+      double total; // of both, computed once per timestep
+    };
+    std::vector<Prefix> beams = {{0, 0.0, log_zero, 0.0}};
+
+    // Prefixes of the next timestep, with their index in next looked up by trie node
+    std::vector<Prefix> next;
+    std::vector<int> slot_of_node;
+    for (int t = 0; t < nb_timesteps_; t++) {
+      const double *row = &log_table_[t * nb_symbols_];
+      next.clear();
+      auto entry = [&](int node) -> Prefix & {
+        if (node >= (int)slot_of_node.size()) {
+          slot_of_node.resize(2 * node + 1, -1);
+        }
+        if (slot_of_node[node] < 0) {
+          slot_of_node[node] = next.size();
+          next.push_back({node, log_zero, log_zero, log_zero});
+        }
+        return next[slot_of_node[node]];
+      };
+      // Reserve so that references returned by entry stay valid within one prefix
+      next.reserve(beams.size() * nb_symbols_);
+      for (const Prefix &prefix : beams) {
+        const double total = prefix.total;
+        const int last = nodes[prefix.node].symbol;
+
+        // A null, or a repeat of the last symbol, leaves the prefix unchanged
+        Prefix &same = entry(prefix.node);
+        same.null_ending = log_sum_exp(same.null_ending, total + row[0]);
+        if (last > 0) {
+          same.symbol_ending = log_sum_exp(same.symbol_ending, prefix.symbol_ending + row[last]);
+        }
+
+        // Any other symbol extends it; the last symbol only extends it after a null
+        for (int symbol = 1; symbol < nb_symbols_; symbol++) {
+          if (row[symbol] <= log_zero) {
+            continue;
+          }
+          Prefix &extended = entry(child(prefix.node, symbol));
+          const double from = symbol == last ? prefix.null_ending : total;
+          extended.symbol_ending = log_sum_exp(extended.symbol_ending, from + row[symbol]);
+        }
+      }
+
+      for (auto &prefix : next) {
+        prefix.total = log_sum_exp(prefix.null_ending, prefix.symbol_ending);
+        slot_of_node[prefix.node] = -1;
+      }
+      if ((int)next.size() > beam_width) {
+        std::nth_element(next.begin(), next.begin() + beam_width, next.end(),
+                         [](const Prefix &x, const Prefix &y) { return x.total > y.total; });
+        next.resize(beam_width);
+      }
+      std::swap(beams, next);
+    }
+
+    // Rescore the survivors exactly; pruning may have dropped some of their paths
+    std::vector<ScoredBeam> scored;
+    scored.reserve(beams.size());
+    for (const Prefix &prefix : beams) {
+      ScoredBeam beam;
+      for (int node = prefix.node; node > 0; node = nodes[node].parent) {
+        beam.symbols.push_back(nodes[node].symbol);
+      }
+      std::reverse(beam.symbols.begin(), beam.symbols.end());
+      beam.log_probability = log_probability(beam.symbols);
+      scored.push_back(std::move(beam));
+    }
+    std::sort(scored.begin(), scored.end(), [](const ScoredBeam &x, const ScoredBeam &y) {
+      return x.log_probability != y.log_probability ? x.log_probability > y.log_probability
+                                                    : x.symbols < y.symbols;
+    });
+    if ((int)scored.size() > top_k) {
+      scored.resize(std::max(top_k, 0));
+    }
+    return scored;
+  }
+
+}
@@ -0,0 +1,107 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/ctc_reference_decoder.hpp"
+#include "qristal/decoder/ctc_reference.hpp"
+
+#include "xacc_service.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace qristal {
+
+  bool CtcReferenceDecoder::initialize(const xacc::HeterogeneousMap &parameters) {
+
+    if (parameters.keyExists<ProbabilityTable>("probability_table")) {
+        probability_table = parameters.get<ProbabilityTable>("probability_table");
+    }
+    else if (parameters.keyExists<std::vector<std::vector<float>>>("probability_table")) {
+        probability_table = parameters.get<std::vector<std::vector<float>>>("probability_table");
+    }
+    else {
+        return false;
+    }
+    if (probability_table.empty()) {
+        return false;
+    }
+    const int nb_timesteps = probability_table.size();
+    const int nb_symbols = probability_table.nb_symbols();
+
+    // Symbol width as for the simplified decoder, from qubits_string if given
+    nq_symbol = std::max(1, (int)std::ceil(std::log2((float)nb_symbols)));
+    if (parameters.keyExists<std::vector<int>>("qubits_string")) {
+        nq_symbol = parameters.get<std::vector<int>>("qubits_string").size() / nb_timesteps;
+    }
+    nq_symbol = parameters.get_or_default("nq_symbol", nq_symbol);
+    if ((1L << std::min(nq_symbol, 62)) < nb_symbols) {
+        throw std::runtime_error("Invalid number of nq_symbol!\n");
+    }
+
+    top_k = parameters.get_or_default("top_k", 10);
+    beam_width = parameters.get_or_default("beam_width", 64);
+    shots = parameters.get_or_default("shots", 1024);
+
+    // Match the beam format of the simplified decoder on the given qpu
+    std::string qpu_name;
+    if (parameters.stringExists("qpu")) {
+        qpu_name = parameters.getString("qpu");
+    } else if (parameters.pointerLikeExists<xacc::Accelerator>("qpu")) {
+        qpu_name = parameters.getPointerLike<xacc::Accelerator>("qpu")->name();
+    }
+    reversed_bit_order = qpu_name == "aer";
+    is_msb = parameters.get_or_default("is_msb", reversed_bit_order);
+
+    return true;
+
+  } //CtcReferenceDecoder::initialize
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  const std::vector<std::string> CtcReferenceDecoder::requiredParameters() const {
+    return {"probability_table"};
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  void CtcReferenceDecoder::execute(
+      const std::shared_ptr<xacc::AcceleratorBuffer> buffer) const {
+
+    const CtcReference reference(probability_table);
+    const std::vector<ScoredBeam> beams = reference.top_beams(top_k, beam_width);
+
+    // Bitstring of a beam as the simplified decoder reports it. Symbols are measured least significant
+    // bit first; reversing the measured string reverses both the symbol order and the bits of each symbol.
+    auto beam_string = [&](const std::vector<int> &symbols) {
+      std::string bitstring;
+      const int n = symbols.size();
+      for (int i = 0; i < n; i++) {
+        const int symbol = symbols[reversed_bit_order != is_msb ? n - 1 - i : i];
+        for (int bit = 0; bit < nq_symbol; bit++) {
+          const int shift = reversed_bit_order ? nq_symbol - 1 - bit : bit;
+          bitstring.push_back((symbol >> shift) & 1 ? '1' : '0');
+        }
+      }
+      return bitstring;
+    };
+
+    if (beams.empty()) {
+        throw std::runtime_error("No beams found!\n");
+    }
+    buffer->addExtraInfo("best_beam", beam_string(beams[0].symbols));
+
+    // Output beams, most probable first, with their expected shot counts and exact probabilities
+    int nb_beams = 0;
+    for (const ScoredBeam &beam : beams) {
+        const double probability = std::exp(beam.log_probability);
+        const std::string label = std::to_string(nb_beams);
+        buffer->addExtraInfo("beam_" + label, beam_string(beam.symbols));
+        buffer->addExtraInfo("beam_count_" + label, (int)std::lround(probability * shots));
+        buffer->addExtraInfo("beam_probability_" + label, probability);
+        nb_beams++;
+    }
+    buffer->addExtraInfo("nb_beams", nb_beams);
+
+  } // CtcReferenceDecoder::execute
+
+}
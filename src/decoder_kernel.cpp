@@ -2,16 +2,177 @@
 
 #include "qristal/core/circuit_builder.hpp"
 #include "qristal/decoder/decoder_kernel.hpp"
+#include "qristal/decoder/resource_plan.hpp"
 
 #include "xacc.hpp"
 
 #include <CompositeInstruction.hpp>
 #include <Instruction.hpp>
+#include <functional>
 #include <memory>
+#include <set>
+#include <string>
 
 
 namespace qristal {
 
+  namespace {
+
+    // Add every qubit an instruction acts on, recursing into composites
+    void collect_qubits(xacc::Instruction &instruction, std::set<int> &qubits) {
+      if (instruction.isComposite()) {
+        for (const auto &inner : dynamic_cast<xacc::CompositeInstruction &>(instruction).getInstructions()) {
+          collect_qubits(*inner, qubits);
+        }
+      } else {
+        for (auto bit : instruction.bits()) {
+          qubits.insert(bit);
+        }
+      }
+    }
+
+    // Multi-controlled X on target, as a GeneralisedMCX
+    xacc::InstPtr mcx(const std::vector<int> &controls_on, const std::vector<int> &controls_off, int target) {
+      auto gate = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+          xacc::getService<xacc::Instruction>("GeneralisedMCX"));
+      gate->expand({{"controls_on", controls_on}, {"controls_off", controls_off}, {"target", target}});
+      return gate;
+    }
+
+    // Number of destination bits per symbol for the compaction network
+    int destination_bits(int string_length) {
+      int nb_bits = 0;
+      while ((1 << nb_bits) < string_length) {
+        nb_bits++;
+      }
+      return nb_bits;
+    }
+
+    // Log-depth alternative to the swap cascade.
+    //
+    // Every symbol gets a destination tag: kept symbols go to the front in their original order and flagged
+    // symbols to the back in reverse order, which is exactly the permutation the cascade applies. With
+    // P = 2^B >= L, the symbols sit right-aligned at virtual positions s..P-1 (s = P-L) of a butterfly network,
+    // and stage b swaps the symbols at positions p and p+2^b whenever the one at p has bit b of its
+    // destination set. With this alignment no two symbols ever compete for a position.
+    //
+    // The tags are filled in with an exclusive prefix count of kept symbols (a Brent-Kung scan of in-place
+    // ripple-carry adders), to which flagged symbols add a constant offset. A tag bit that has steered its
+    // stage stays behind as a record of the switch, so no switch qubit needs to be uncomputed. The tags and
+    // records are a function of the null and repeat flags only, so they do not split any beam class.
+    //
+    // Gates are O(L log^2 L) in the worst case, from the offsets, and depth is O(log^2 L).
+    void add_compaction_network(const std::vector<int> &qubits_string, const std::vector<int> &qubits_init_null,
+                                const std::vector<int> &qubits_init_repeat,
+                                const std::vector<int> &qubits_superfluous_flags,
+                                const std::vector<int> &qubits_scratch,
+                                const std::function<void(const xacc::InstPtr &)> &add) {
+      auto gateRegistry = xacc::getService<xacc::IRProvider>("quantum");
+      const int L = qubits_init_null.size();
+      const int S = qubits_string.size()/L;
+      const int B = destination_bits(L);
+      const int s = (1 << B) - L;
+
+      // flag symbols that are a null or a repeat
+      for (int i = 0; i < L; i++) {
+        add(gateRegistry->createInstruction("X", qubits_superfluous_flags[i]));
+        add(mcx({}, {qubits_init_null[i], qubits_init_repeat[i]}, qubits_superfluous_flags[i]));
+      }
+      if (B == 0) {
+        return;
+      }
+
+      std::vector<std::vector<int>> tags(L);
+      for (int i = 0; i < L; i++) {
+        tags[i].assign(qubits_scratch.begin() + i*B, qubits_scratch.begin() + (i + 1)*B);
+      }
+      const std::vector<int> carries(qubits_scratch.begin() + L*B, qubits_scratch.end());
+
+      // tag_i = s + (number of kept symbols before i), as an inclusive scan of s, k_0, ..., k_{L-2}
+      for (int b = 0; b < B; b++) {
+        if ((s >> b) & 1) {
+          add(gateRegistry->createInstruction("X", tags[0][b]));
+        }
+      }
+      for (int i = 1; i < L; i++) {
+        add(gateRegistry->createInstruction("X", tags[i][0]));
+        add(gateRegistry->createInstruction(
+            "CX", {static_cast<unsigned long>(qubits_superfluous_flags[i - 1]),
+                   static_cast<unsigned long>(tags[i][0])}));
+      }
+
+      // target += source (mod 2^B), ripple-carry with a clean carry qubit
+      auto add_tags = [&](const std::vector<int> &target, const std::vector<int> &source, int carry) {
+        auto cx = [&](int control, int qubit) {
+          add(gateRegistry->createInstruction(
+              "CX", {static_cast<unsigned long>(control), static_cast<unsigned long>(qubit)}));
+        };
+        auto majority = [&](int x, int y, int z) { cx(z, y); cx(z, x); add(mcx({x, y}, {}, z)); };
+        auto unmajority = [&](int x, int y, int z) { add(mcx({x, y}, {}, z)); cx(z, x); cx(x, y); };
+        majority(carry, target[0], source[0]);
+        for (int b = 1; b < B; b++) {
+          majority(source[b - 1], target[b], source[b]);
+        }
+        for (int b = B - 1; b > 0; b--) {
+          unmajority(source[b - 1], target[b], source[b]);
+        }
+        unmajority(carry, target[0], source[0]);
+      };
+      int stride = 1;
+      for (; stride < L; stride *= 2) {
+        for (int j = 2*stride - 1, n = 0; j < L; j += 2*stride, n++) {
+          add_tags(tags[j], tags[j - stride], carries[n]);
+        }
+      }
+      for (stride /= 2; stride >= 1; stride /= 2) {
+        for (int j = 3*stride - 1, n = 0; j < L; j += 2*stride, n++) {
+          add_tags(tags[j], tags[j - stride], carries[n]);
+        }
+      }
+
+      // A flagged symbol goes to P - 1 - (number of flagged symbols before i) = tag_i + L - 1 - i
+      for (int i = 0; i < L; i++) {
+        const int offset = L - 1 - i;
+        for (int t = 0; t < B; t++) {
+          if (!((offset >> t) & 1)) {
+            continue;
+          }
+          // increment tag_i[t:] controlled on the flag
+          for (int u = B - 1; u >= t; u--) {
+            std::vector<int> controls = {qubits_superfluous_flags[i]};
+            controls.insert(controls.end(), tags[i].begin() + t, tags[i].begin() + u);
+            add(mcx(controls, {}, tags[i][u]));
+          }
+        }
+      }
+
+      // Route on the destination bits, least significant first
+      for (int b = 0; b < B; b++) {
+        for (int p = s; p < (1 << B); p++) {
+          if ((p >> b) & 1) {
+            continue;
+          }
+          const int i = p - s;
+          const int j = (p | (1 << b)) - s;
+          std::vector<int> qubits_a(qubits_string.begin() + i*S, qubits_string.begin() + (i + 1)*S);
+          std::vector<int> qubits_b(qubits_string.begin() + j*S, qubits_string.begin() + (j + 1)*S);
+          qubits_a.push_back(qubits_superfluous_flags[i]);
+          qubits_b.push_back(qubits_superfluous_flags[j]);
+          qubits_a.insert(qubits_a.end(), tags[i].begin() + b + 1, tags[i].end());
+          qubits_b.insert(qubits_b.end(), tags[j].begin() + b + 1, tags[j].end());
+          auto c_swap = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+              xacc::getService<xacc::Instruction>("ControlledSwap"));
+          std::vector<int> flags_on = {tags[i][b]};
+          const bool expand_ok = c_swap->expand(
+              {{"qubits_a", qubits_a}, {"qubits_b", qubits_b}, {"flags_on", flags_on}});
+          assert(expand_ok);
+          add(c_swap);
+        }
+      }
+    }
+
+  }
+
   bool DecoderKernel::expand(const xacc::HeterogeneousMap &runtimeOptions) {
 
     ////////////////////////////////////////////////////////
@@ -127,10 +288,21 @@ namespace qristal {
         total_metric_exponent = runtimeOptions.get<std::vector<int>>("total_metric_exponenet");
     }
 
-    if (!runtimeOptions.pointerLikeExists<xacc::CompositeInstruction>("metric_state_prep")) {
+    // Shared with the caller's circuit, so taken as the shared composite rather than a copy
+    if (!runtimeOptions.keyExists<std::shared_ptr<xacc::CompositeInstruction>>("metric_state_prep")) {
+      return false;
+    }
+    auto metric_state_prep = runtimeOptions.get<std::shared_ptr<xacc::CompositeInstruction>>("metric_state_prep");
+
+    // "cascade" (default) moves each flagged symbol to the end through a chain of controlled swaps;
+    // "network" applies the same permutation with a log-depth routing network
+    std::string compaction = "cascade";
+    if (runtimeOptions.stringExists("compaction")) {
+      compaction = runtimeOptions.getString("compaction");
+    }
+    if (compaction != "cascade" && compaction != "network") {
       return false;
     }
-    auto metric_state_prep = runtimeOptions.getPointerLike<xacc::CompositeInstruction>("metric_state_prep");
 
     int L = qubits_init_null.size();
     int S = qubits_string.size()/L;
@@ -170,131 +342,142 @@ namespace qristal {
 
     // flag superfluous symbols and mark for swap
 
-    for (int i = L - 1; i >= 0; i--) {
-      std::vector<int> letter;
-      for (int j = 0; j < S; j++) {
-        letter.push_back(qubits_string[i * S + j]);
-      }
+    // The cascade is built once as an immutable sub-circuit shared by the kernel and the adder's state
+    // preparation. The qubits used by the latter are tracked as gates are added, instead of cloning it.
+    auto cascade = gateRegistry->createComposite("superfluous_cascade");
+    std::set<int> sp_qubits;
+    collect_qubits(*metric_state_prep, sp_qubits);
+    auto add_to_cascade = [&](const xacc::InstPtr &instruction) {
+      cascade->addInstruction(instruction);
+      collect_qubits(*instruction, sp_qubits);
+    };
 
-      // flag last symbol if it is null or repeat
-      if (i == L - 1) {
-        addInstruction(
-            gateRegistry->createInstruction("X", qubits_superfluous_flags[i]));
-        metric_state_prep->addInstruction(
-            gateRegistry->createInstruction("X", qubits_superfluous_flags[i]));
-        auto untoffoli = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
-            xacc::getService<xacc::Instruction>("GeneralisedMCX"));
-        std::vector<int> off;
-        off.push_back(qubits_init_null[i]);
-        off.push_back(qubits_init_repeat[i]);
-        untoffoli->expand(
-            {{"controls_off", off}, {"target", qubits_superfluous_flags[i]}});
-        addInstruction(untoffoli);
-        metric_state_prep->addInstruction(untoffoli);
+    // The network's scratch qubits come from the ancilla pool, clear of the state preparation and of the
+    // three qubits reserved for the superposition adder
+    if (compaction == "network") {
+      std::vector<int> qubits_scratch;
+      const int nb_scratch = compaction_network_ancilla(L);
+      for (int i = 3; i < (int)qubits_ancilla_pool.size() && (int)qubits_scratch.size() < nb_scratch; i++) {
+        if (!sp_qubits.count(qubits_ancilla_pool[i])) {
+          qubits_scratch.push_back(qubits_ancilla_pool[i]);
+        }
+      }
+      if ((int)qubits_scratch.size() < nb_scratch) {
+        return false;
       }
+      add_compaction_network(qubits_string, qubits_init_null, qubits_init_repeat, qubits_superfluous_flags,
+                             qubits_scratch, add_to_cascade);
+    } else {
+      for (int i = L - 1; i >= 0; i--) {
+        std::vector<int> letter;
+        for (int j = 0; j < S; j++) {
+          letter.push_back(qubits_string[i * S + j]);
+        }
 
-      // loop from second last symbol to first symbol
-      else {
-        // flag if it is a repeat or a null
-        addInstruction(
-            gateRegistry->createInstruction("X", qubits_superfluous_flags[i]));
-        metric_state_prep->addInstruction(
-            gateRegistry->createInstruction("X", qubits_superfluous_flags[i]));
-        auto untoffoli = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
-            xacc::getService<xacc::Instruction>("GeneralisedMCX"));
-        std::vector<int> off;
-        off.push_back(qubits_init_null[i]);
-        off.push_back(qubits_init_repeat[i]);
-        untoffoli->expand(
-            {{"controls_off", off}, {"target", qubits_superfluous_flags[i]}});
-        addInstruction(untoffoli);
-        metric_state_prep->addInstruction(untoffoli);
-
-        // flip control-swap qubit according to whether that symbol is a repeat or
-        // a null
-        int qubit_control_swap = qubits_ancilla_pool[0];
-        addInstruction(gateRegistry->createInstruction(
-            "CX", {static_cast<unsigned long>(qubits_superfluous_flags[i]),
-                   static_cast<unsigned long>(qubit_control_swap)}));
-        metric_state_prep->addInstruction(gateRegistry->createInstruction(
-            "CX", {static_cast<unsigned long>(qubits_superfluous_flags[i]),
-                   static_cast<unsigned long>(qubit_control_swap)}));
-
-        // loop from current symbol to the end
-        for (int j = i; j < L - 1; j++) {
-          std::vector<int> current_letter;
-          std::vector<int> next_letter;
-          std::vector<int> current_flag = {qubits_superfluous_flags[j]};
-          std::vector<int> next_flag = {qubits_superfluous_flags[j + 1]};
-
-          for (int k = 0; k < S; k++) {
-            current_letter.push_back(
-                qubits_string[j * S + k]);
-          }
-          for (int k = 0; k < S; k++) {
-            next_letter.push_back(
-                qubits_string[(j + 1) * S + k]);
-          }
+        // flag last symbol if it is null or repeat
+        if (i == L - 1) {
+          add_to_cascade(
+              gateRegistry->createInstruction("X", qubits_superfluous_flags[i]));
+          auto untoffoli = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+              xacc::getService<xacc::Instruction>("GeneralisedMCX"));
+          std::vector<int> off;
+          off.push_back(qubits_init_null[i]);
+          off.push_back(qubits_init_repeat[i]);
+          untoffoli->expand(
+              {{"controls_off", off}, {"target", qubits_superfluous_flags[i]}});
+          add_to_cascade(untoffoli);
+        }
 
-          // swap flagged symbol (swap conditional on control-swap) with next one
-          auto c_swap_letter =
-              std::dynamic_pointer_cast<xacc::CompositeInstruction>(
-                  xacc::getService<xacc::Instruction>("ControlledSwap"));
-          std::vector<int> flags_on = {qubit_control_swap};
-          xacc::HeterogeneousMap options_letter{{"qubits_a", current_letter},
-                                                {"qubits_b", next_letter},
+        // loop from second last symbol to first symbol
+        else {
+          // flag if it is a repeat or a null
+          add_to_cascade(
+              gateRegistry->createInstruction("X", qubits_superfluous_flags[i]));
+          auto untoffoli = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+              xacc::getService<xacc::Instruction>("GeneralisedMCX"));
+          std::vector<int> off;
+          off.push_back(qubits_init_null[i]);
+          off.push_back(qubits_init_repeat[i]);
+          untoffoli->expand(
+              {{"controls_off", off}, {"target", qubits_superfluous_flags[i]}});
+          add_to_cascade(untoffoli);
+
+          // flip control-swap qubit according to whether that symbol is a repeat or
+          // a null
+          int qubit_control_swap = qubits_ancilla_pool[0];
+          add_to_cascade(gateRegistry->createInstruction(
+              "CX", {static_cast<unsigned long>(qubits_superfluous_flags[i]),
+                     static_cast<unsigned long>(qubit_control_swap)}));
+
+          // loop from current symbol to the end
+          for (int j = i; j < L - 1; j++) {
+            std::vector<int> current_letter;
+            std::vector<int> next_letter;
+            std::vector<int> current_flag = {qubits_superfluous_flags[j]};
+            std::vector<int> next_flag = {qubits_superfluous_flags[j + 1]};
+
+            for (int k = 0; k < S; k++) {
+              current_letter.push_back(
+                  qubits_string[j * S + k]);
+            }
+            for (int k = 0; k < S; k++) {
+              next_letter.push_back(
+                  qubits_string[(j + 1) * S + k]);
+            }
+
+            // swap flagged symbol (swap conditional on control-swap) with next one
+            auto c_swap_letter =
+                std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+                    xacc::getService<xacc::Instruction>("ControlledSwap"));
+            std::vector<int> flags_on = {qubit_control_swap};
+            xacc::HeterogeneousMap options_letter{{"qubits_a", current_letter},
+                                                  {"qubits_b", next_letter},
+                                                  {"flags_on", flags_on}};
+            const bool expand_ok_letter = c_swap_letter->expand(options_letter);
+            assert(expand_ok_letter);
+            add_to_cascade(c_swap_letter);
+
+            // swap superfluous flag (swap conditional on control-swap) with next
+            // one
+            auto c_swap_flag =
+                std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+                    xacc::getService<xacc::Instruction>("ControlledSwap"));
+            xacc::HeterogeneousMap options_flag{{"qubits_a", current_flag},
+                                                {"qubits_b", next_flag},
                                                 {"flags_on", flags_on}};
-          const bool expand_ok_letter = c_swap_letter->expand(options_letter);
-          assert(expand_ok_letter);
-          addInstruction(c_swap_letter);
-          metric_state_prep->addInstruction(c_swap_letter);
-
-          // swap superfluous flag (swap conditional on control-swap) with next
-          // one
-          auto c_swap_flag =
-              std::dynamic_pointer_cast<xacc::CompositeInstruction>(
-                  xacc::getService<xacc::Instruction>("ControlledSwap"));
-          xacc::HeterogeneousMap options_flag{{"qubits_a", current_flag},
-                                              {"qubits_b", next_flag},
-                                              {"flags_on", flags_on}};
-          const bool expand_ok_flag = c_swap_flag->expand(options_flag);
-          assert(expand_ok_flag);
-          addInstruction(c_swap_flag);
-          metric_state_prep->addInstruction(c_swap_flag);
-        }
+            const bool expand_ok_flag = c_swap_flag->expand(options_flag);
+            assert(expand_ok_flag);
+            add_to_cascade(c_swap_flag);
+          }
 
-        // flip control-swap qubit back according to whether that symbol is a
-        // repeat or a null
-        addInstruction(gateRegistry->createInstruction("X", qubit_control_swap));
-        metric_state_prep->addInstruction(gateRegistry->createInstruction("X", qubit_control_swap));
-        auto untoffoli2 = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
-            xacc::getService<xacc::Instruction>("GeneralisedMCX"));
-        std::vector<int> off2;
-        off2.push_back(qubits_init_null[i]);
-        off2.push_back(qubits_init_repeat[i]);
-        untoffoli2->expand(
-            {{"controls_off", off2}, {"target", qubit_control_swap}});
-        addInstruction(untoffoli2);
-        metric_state_prep->addInstruction(untoffoli2);
+          // flip control-swap qubit back according to whether that symbol is a
+          // repeat or a null
+          add_to_cascade(gateRegistry->createInstruction("X", qubit_control_swap));
+          auto untoffoli2 = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+              xacc::getService<xacc::Instruction>("GeneralisedMCX"));
+          std::vector<int> off2;
+          off2.push_back(qubits_init_null[i]);
+          off2.push_back(qubits_init_repeat[i]);
+          untoffoli2->expand(
+              {{"controls_off", off2}, {"target", qubit_control_swap}});
+          add_to_cascade(untoffoli2);
+        }
       }
     }
+    addInstruction(cascade);
+
+    // The state preparation the adder estimates: metric_state_prep then the cascade, both shared
+    auto ae_state_prep = gateRegistry->createComposite("metric_state_prep");
+    ae_state_prep->addInstruction(metric_state_prep);
+    ae_state_prep->addInstruction(cascade);
 
     int q0 = qubits_ancilla_pool[0];
     int q1 = qubits_ancilla_pool[1];
     int q2 = qubits_ancilla_pool[2];
 
-    std::shared_ptr<xacc::CompositeInstruction> sp_c =
-        xacc::ir::asComposite(metric_state_prep->clone());
-    auto state_prep_set = qristal::uniqueBitsQD(sp_c);
-    std::vector<int> sp_qubits;
-    for (auto bit : state_prep_set) {
-        sp_qubits.push_back(bit);
-    }
-
     std::vector<int> qubits_ancilla;
     for (int i = 3; i < qubits_ancilla_pool.size(); i++) {
-      if (std::find(sp_qubits.begin(), sp_qubits.end(), qubits_ancilla_pool[i]) ==
-          sp_qubits.end()) {
+      if (!sp_qubits.count(qubits_ancilla_pool[i])) {
         qubits_ancilla.push_back(qubits_ancilla_pool[i]);
       }
     }
@@ -306,7 +489,7 @@ namespace qristal {
         {"qubits_flags", qubits_superfluous_flags},
         {"qubits_string", qubits_string},
         {"qubits_metric", qubits_total_metric},
-        {"ae_state_prep_circ", metric_state_prep},
+        {"ae_state_prep_circ", ae_state_prep},
         {"qubits_ancilla", qubits_ancilla},
         {"qubits_beam_metric", qubits_beam_metric}};
     const bool expand_ok_add = add_metrics->expand(options_adder);
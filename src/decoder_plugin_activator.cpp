@@ -1,5 +1,6 @@
 // Copyright (c) Quantum Brilliance Pty Ltd
 
+#include "qristal/decoder/ctc_reference_decoder.hpp"
 #include "qristal/decoder/decoder_kernel.hpp"
 #include "qristal/decoder/quantum_decoder.hpp"
 
@@ -26,6 +27,9 @@ class US_ABI_LOCAL qbDecoderActivator : public BundleActivator {
         // Register QuantumDecoder as an Algorithm
         context.RegisterService<xacc::Algorithm>(
             std::make_shared<qristal::QuantumDecoder>());
+        // Register the classical CTC reference decoder as an Algorithm
+        context.RegisterService<xacc::Algorithm>(
+            std::make_shared<qristal::CtcReferenceDecoder>());
     }
 
     void Stop(BundleContext) {}
@@ -0,0 +1,136 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/direct_sampler.hpp"
+#include "qristal/decoder/beam_aggregation.hpp"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+namespace qristal {
+
+  namespace {
+
+    // splitmix64, used to derive independent shard seeds from one seed
+    std::uint64_t mix_seed(std::uint64_t x) {
+      x += 0x9e3779b97f4a7c15ULL;
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      return x ^ (x >> 31);
+    }
+
+    std::uint64_t reverse_bits(std::uint64_t value, int nb_bits) {
+      std::uint64_t reversed = 0;
+      for (int bit = 0; bit < nb_bits; bit++) {
+        reversed = (reversed << 1) | ((value >> bit) & 1);
+      }
+      return reversed;
+    }
+
+  }
+
+  AliasTable::AliasTable(const std::vector<float> &probabilities) : nb_symbols_(probabilities.size()) {
+    const std::size_t n = probabilities.size();
+    double sum = 0.0;
+    for (float p : probabilities) {
+      if (!(p >= 0.0f)) {
+        throw std::runtime_error("Probabilities must be non-negative!\n");
+      }
+      sum += p;
+    }
+    if (n == 0 || !(sum > 0.0)) {
+      throw std::runtime_error("Every row of the probability table needs a non-zero probability!\n");
+    }
+
+    // Vose's method: pair each under-full column with an over-full one
+    std::vector<double> scaled(n);
+    std::vector<std::size_t> small, large;
+    for (std::size_t i = 0; i < n; i++) {
+      scaled[i] = probabilities[i] * n / sum;
+      (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+    threshold_.assign(n, std::uint64_t(1) << 32);
+    alias_.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+      alias_[i] = int(i);
+    }
+    while (!small.empty() && !large.empty()) {
+      const std::size_t s = small.back();
+      small.pop_back();
+      const std::size_t l = large.back();
+      threshold_[s] = static_cast<std::uint64_t>(std::max(scaled[s], 0.0) * 4294967296.0);
+      alias_[s] = int(l);
+      scaled[l] -= 1.0 - scaled[s];
+      if (scaled[l] < 1.0) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    // Columns left over are full up to rounding error and keep their threshold of 2^32
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  DirectSampler::DirectSampler(const ProbabilityTable &probability_table, int nq_symbol,
+                               bool reversed_bit_order, const std::vector<std::vector<int>> &row_symbols)
+      : nq_symbol_(nq_symbol) {
+    const int nb_timesteps = probability_table.size();
+    if (!row_symbols.empty() && (int)row_symbols.size() != nb_timesteps) {
+      throw std::runtime_error("Row symbols do not match the probability table!\n");
+    }
+    for (int position = 0; position < nb_timesteps; position++) {
+      // Symbol bits are measured least significant first, so in measured string order a symbol's field
+      // holds its bits reversed. Reversing the whole string also reverses the timesteps and restores the
+      // natural bit order within each symbol.
+      const int t = reversed_bit_order ? nb_timesteps - 1 - position : position;
+      const ProbabilityTable::Row row = probability_table[t];
+      std::vector<std::uint64_t> symbols(row.size());
+      for (std::size_t s = 0; s < row.size(); s++) {
+        symbols[s] = row_symbols.empty() ? s : row_symbols[t].at(s);
+      }
+      if (nq_symbol < 64 && !symbols.empty() &&
+          *std::max_element(symbols.begin(), symbols.end()) >= (std::uint64_t(1) << nq_symbol)) {
+        throw std::runtime_error("Too many symbols for nq_symbol!\n");
+      }
+      rows_.emplace_back(std::vector<float>(row.begin(), row.end()));
+      std::vector<std::uint64_t> fields(row.size());
+      for (std::size_t s = 0; s < row.size(); s++) {
+        fields[s] = reversed_bit_order ? symbols[s] : reverse_bits(symbols[s], nq_symbol);
+      }
+      fields_.push_back(std::move(fields));
+    }
+  }
+
+  std::vector<std::pair<PackedBeam, int>> DirectSampler::sample_beams(int shots, const BeamCollapser &collapser,
+                                                                      std::uint64_t seed, int nb_threads) const {
+    if (collapser.nb_timesteps() != (int)rows_.size() || collapser.nq_symbol() != nq_symbol_) {
+      throw std::runtime_error("Beam collapser does not match the probability table!\n");
+    }
+
+    // Sampling a shot costs about as much as collapsing a measured string
+    const std::size_t min_shots_per_shard = 2048;
+    return aggregate_sharded(std::max(shots, 0), nb_threads, min_shots_per_shard,
+        [&](std::size_t begin, std::size_t end, PartitionedBeamCounts &counts) {
+          std::mt19937_64 rng(mix_seed(seed ^ mix_seed(begin)));
+          const int spw = collapser.symbols_per_word();
+          const int nb_timesteps = rows_.size();
+          std::vector<std::uint64_t> words(collapser.nb_words());
+          PackedBeam beam;
+          for (std::size_t shot = begin; shot < end; shot++) {
+            int position = 0;
+            for (auto &word : words) {
+              // Fill the word top field first; a short final word keeps its unused low fields zero
+              std::uint64_t packed = 0;
+              int field = 0;
+              for (; field < spw && position < nb_timesteps; field++, position++) {
+                packed = (packed << nq_symbol_) | fields_[position][rows_[position].sample(rng())];
+              }
+              word = packed << ((spw - field) * nq_symbol_);
+            }
+            collapser.collapse_packed(words.data(), beam);
+            counts.add(beam, 1);
+          }
+        });
+  }
+
+}
@@ -0,0 +1,64 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/probability_table.hpp"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+namespace qristal {
+
+  namespace {
+
+    // Uninitialised, aligned storage for n probabilities
+    std::shared_ptr<float> allocate(std::size_t n) {
+      float *data = static_cast<float *>(::operator new[](std::max<std::size_t>(n, 1) * sizeof(float),
+                                                           std::align_val_t(ProbabilityTable::alignment)));
+      return std::shared_ptr<float>(data, [](float *p) {
+        ::operator delete[](p, std::align_val_t(ProbabilityTable::alignment));
+      });
+    }
+
+  }
+
+  ProbabilityTable::ProbabilityTable(const std::vector<std::vector<float>> &rows)
+      : nb_timesteps_(rows.size()), nb_symbols_(rows.empty() ? 0 : rows[0].size()) {
+    auto data = allocate(nb_timesteps_ * nb_symbols_);
+    for (std::size_t t = 0; t < nb_timesteps_; t++) {
+      if (rows[t].size() != nb_symbols_) {
+        throw std::runtime_error("All rows of the probability table must have the same length!\n");
+      }
+      std::copy(rows[t].begin(), rows[t].end(), data.get() + t * nb_symbols_);
+    }
+    data_ = std::move(data);
+  }
+
+  ProbabilityTable::ProbabilityTable(const float *data, std::size_t nb_timesteps, std::size_t nb_symbols)
+      : nb_timesteps_(nb_timesteps), nb_symbols_(nb_symbols) {
+    auto copy = allocate(nb_timesteps * nb_symbols);
+    std::copy(data, data + nb_timesteps * nb_symbols, copy.get());
+    data_ = std::move(copy);
+  }
+
+  ProbabilityTable ProbabilityTable::view(const float *data, std::size_t nb_timesteps, std::size_t nb_symbols,
+                                          std::shared_ptr<const void> owner) {
+    ProbabilityTable table;
+    // Shares ownership of owner, which may be empty, while pointing at data
+    table.data_ = std::shared_ptr<const float>(std::move(owner), data);
+    table.nb_timesteps_ = nb_timesteps;
+    table.nb_symbols_ = nb_symbols;
+    return table;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<std::vector<float>> ProbabilityTable::to_rows() const {
+    std::vector<std::vector<float>> rows;
+    rows.reserve(nb_timesteps_);
+    for (Row row : *this) {
+      rows.emplace_back(row.begin(), row.end());
+    }
+    return rows;
+  }
+
+}
@@ -1,68 +1,288 @@
 // Copyright (c) 2022 Quantum Brilliance Pty Ltd
 
 #include "qristal/decoder/quantum_decoder.hpp"
+#include "qristal/decoder/accelerator_pool.hpp"
+#include "qristal/decoder/ancilla_liveness.hpp"
+#include "qristal/decoder/batch.hpp"
+#include "qristal/decoder/ctc_reference.hpp"
+#include "qristal/decoder/lru_cache.hpp"
+#include "qristal/decoder/resource_plan.hpp"
+#include "qristal/decoder/thread_pool.hpp"
+#include "qristal/decoder/timestep_pruning.hpp"
 
 #include "Algorithm.hpp"
 #include "xacc.hpp"
 #include "xacc_service.hpp"
 
+#include <algorithm>
 #include <assert.h>
-#include <bitset>
+#include <chrono>
+#include <functional>
 #include <iomanip>
+#include <map>
 #include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
 
 namespace qristal {
 
+  namespace {
+
+    // Append the raw bytes of a vector, preceded by its size, to a cache key
+    template <typename T>
+    void append_key(std::string &key, const std::vector<T> &values) {
+      const std::size_t n = values.size();
+      key.append(reinterpret_cast<const char *>(&n), sizeof(n));
+      key.append(reinterpret_cast<const char *>(values.data()), n * sizeof(T));
+    }
+
+    // The string register holding a beam as the decoder kernel leaves it: the beam's symbols first, S bits
+    // each, least significant first, then nulls
+    std::string string_register_bits(const std::vector<int> &beam, int L, int S) {
+      std::string bits(L * S, '0');
+      for (std::size_t k = 0; k < beam.size() && (int)k < L; k++) {
+        for (int b = 0; b < S; b++) {
+          if ((beam[k] >> b) & 1) {
+            bits[k * S + b] = '1';
+          }
+        }
+      }
+      return bits;
+    }
+
+    // Blocks of the state preparation circuit that do not depend on the probability table
+    struct StatePrepTemplate {
+      std::vector<std::vector<std::shared_ptr<xacc::CompositeInstruction>>> rounds; // per iteration, after W prime
+      std::vector<std::shared_ptr<xacc::CompositeInstruction>> adders;              // total metric adder chain
+    };
+
+    // Process-wide cache of state preparation templates, keyed by register layout
+    LruCache<std::string, std::shared_ptr<const StatePrepTemplate>> &state_prep_template_cache() {
+      static LruCache<std::string, std::shared_ptr<const StatePrepTemplate>> cache(16);
+      return cache;
+    }
+
+    // Process-wide caches of comparator cores, keyed by register layout, and of oracles, keyed by layout and score
+    LruCache<std::string, std::shared_ptr<xacc::CompositeInstruction>> &comparator_cache() {
+      static LruCache<std::string, std::shared_ptr<xacc::CompositeInstruction>> cache(16);
+      return cache;
+    }
+
+    LruCache<std::string, std::shared_ptr<xacc::CompositeInstruction>> &oracle_cache() {
+      static LruCache<std::string, std::shared_ptr<xacc::CompositeInstruction>> cache(256);
+      return cache;
+    }
+
+    // The ancilla liveness analysis' view of a circuit. Gates are numbered by their index in gates.
+    CircuitNode circuit_node(const xacc::InstPtr &instruction, std::vector<xacc::InstPtr> &gates) {
+      CircuitNode node;
+      node.name = instruction->name();
+      if (instruction->isComposite()) {
+        node.composite = true;
+        for (const auto &child : xacc::ir::asComposite(instruction)->getInstructions()) {
+          node.children.push_back(circuit_node(child, gates));
+        }
+        return node;
+      }
+      const std::vector<std::size_t> bits = instruction->bits();
+      node.qubits.assign(bits.begin(), bits.end());
+      for (const auto &parameter : instruction->getParameters()) {
+        if (parameter.isVariable()) {
+          node.name.clear(); // an unknown gate to the analysis
+          break;
+        }
+        node.parameters.push_back(parameter.as<double>());
+      }
+      node.id = gates.size();
+      gates.push_back(instruction);
+      return node;
+    }
+
+    // Rebuild a circuit with its ancillas remapped onto as few pool qubits as liveness allows, gate by gate
+    std::shared_ptr<xacc::CompositeInstruction> remap_ancillas(
+        const std::shared_ptr<xacc::CompositeInstruction> &circuit, const std::vector<int> &ancilla_pool,
+        const std::vector<int> &reserved) {
+      std::vector<xacc::InstPtr> gates;
+      const AncillaReuse reuse = reuse_ancillas(circuit_node(circuit, gates), ancilla_pool, reserved);
+      auto remapped = xacc::getService<xacc::IRProvider>("quantum")->createComposite(circuit->name());
+      for (const auto &gate : reuse.gates) {
+        auto instruction = gates[gate.id]->clone();
+        instruction->setBits(std::vector<std::size_t>(gate.qubits.begin(), gate.qubits.end()));
+        remapped->addInstruction(instruction);
+      }
+      return remapped;
+    }
+
+    // Process-wide cache of state preparation circuits, shared by all QuantumDecoder instances.
+    // Cached circuits are shared between executions and must not be modified.
+    LruCache<std::string, std::shared_ptr<xacc::CompositeInstruction>> &state_prep_cache() {
+      static LruCache<std::string, std::shared_ptr<xacc::CompositeInstruction>> cache(16);
+      return cache;
+    }
+
+  }
+
   bool QuantumDecoder::initialize(const xacc::HeterogeneousMap &parameters) {
 
-    // W prime unitary parameters
-    iteration = parameters.get<int>("iteration");
+    // A batch of tables, each decoded as if given alone (see execute_batch), on the automatic register
+    // layout of its shape unless all share one shape. The first table checks the parameters.
+    probability_tables = {};
+    if (parameters.keyExists<std::vector<std::vector<std::vector<float>>>>("probability_tables")) {
+      probability_tables = parameters.get<std::vector<std::vector<std::vector<float>>>>("probability_tables");
+      if (probability_tables.empty()) {
+        return false;
+      }
+      return initialize_table(parameters, probability_tables[0]);
+    }
 
-    probability_table = {};
-    if (parameters.keyExists<std::vector<std::vector<float>>>(
-            "probability_table")) {
-      probability_table =
-          parameters.get<std::vector<std::vector<float>>>("probability_table");
+    // A ProbabilityTable is shared as is, nested vectors are copied into one
+    ProbabilityTable table;
+    if (parameters.keyExists<ProbabilityTable>("probability_table")) {
+      table = parameters.get<ProbabilityTable>("probability_table");
+    } else if (parameters.keyExists<std::vector<std::vector<float>>>(
+                   "probability_table")) {
+      table = parameters.get<std::vector<std::vector<float>>>("probability_table");
+    }
+    return initialize_table(parameters, table);
+  } //QuantumDecoder::initialize
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  bool QuantumDecoder::initialize_table(const xacc::HeterogeneousMap &parameters, const ProbabilityTable &table) {
+
+    probability_table = table;
+    if (probability_table.empty()) {
+      return false;
+    }
+    parameters_ = parameters;
+
+    // Classical pruning of decided null and repeat timesteps before encoding (see timestep_pruning.hpp), off
+    // by default. Registers given explicitly for the original table keep the qubits of its first timesteps.
+    const int original_timesteps = probability_table.size();
+    prune_blank_threshold = parameters.get_or_default("prune_blank_threshold", 1.0);
+    prune_repeat_threshold = parameters.get_or_default("prune_repeat_threshold", 1.0);
+    pruned_.reset();
+    if (probability_tables.empty() && (prune_blank_threshold < 1.0 || prune_repeat_threshold < 1.0)) {
+      pruned_ = prune_timesteps(probability_table, prune_blank_threshold, prune_repeat_threshold);
+      probability_table = pruned_->probability_table;
     }
 
     int num_timesteps = probability_table.size();
-    int alphabet_size = probability_table[0].size();
+    int alphabet_size = probability_table.nb_symbols();
+    auto timestep_register = [&](const std::string &name) {
+      std::vector<int> qubits = parameters.get<std::vector<int>>(name);
+      qubits.resize(qubits.size() / original_timesteps * num_timesteps);
+      return qubits;
+    };
+
+    // W prime unitary parameters, one iteration per row. An iteration count given for the original table
+    // is cut to the pruned table's rows.
+    iteration = parameters.get_or_default("iteration", num_timesteps);
+    if (pruned_) {
+      iteration = std::min(iteration, num_timesteps);
+    }
+
+    // Compaction mode of the decoder kernel, "cascade" (default) or "network"
+    compaction = "cascade";
+    if (parameters.stringExists("compaction")) {
+      compaction = parameters.getString("compaction");
+    }
+
+    // Exponential search method: "canonical" (default), "CQAE" or "MLQAE". The amplitude estimation
+    // methods take their settings from the options of the same names in exponential-search.
+    method = "canonical";
+    if (parameters.stringExists("method")) {
+      method = parameters.getString("method");
+    }
+    if (method != "canonical" && method != "CQAE" && method != "MLQAE") {
+      return false;
+    }
+    qae_options = {};
+    for (const std::string key : {"CQAE_num_evaluation_qubits", "MLQAE_num_runs", "MLQAE_num_shots"}) {
+      if (parameters.keyExists<int>(key)) {
+        qae_options[key] = parameters.get<int>(key);
+      }
+    }
+
+    // Stopping policies of the N_TRIALS loop, each disabled by default: stop after patience trials in a row
+    // without a better score, once the best score reaches target_score, or once time_budget seconds have
+    // passed since the first trial
+    patience = parameters.get_or_default("patience", 0);
+    target_score = parameters.get_or_default("target_score", -1);
+    time_budget = parameters.get_or_default("time_budget", 0.0);
+
+    // Classical warm start of the best score: "none" (default), "greedy" (best path) or "beam" (beam search)
+    warm_start = "none";
+    if (parameters.stringExists("warm_start")) {
+      warm_start = parameters.getString("warm_start");
+    }
+    if (warm_start != "none" && warm_start != "greedy" && warm_start != "beam") {
+      return false;
+    }
+    warm_start_beam_width = parameters.get_or_default("warm_start_beam_width", 8);
+
+    // Remap the ancillas of the state preparation onto as few pool qubits as possible (see ancilla_liveness.hpp)
+    reuse_ancilla = parameters.get_or_default("reuse_ancilla", false);
+
+    // Without qubits_metric, every register is laid out automatically from the table and metric_precision.
+    // Registers given explicitly still take precedence.
+    DecoderLayout layout;
+    const bool auto_layout = !parameters.keyExists<std::vector<int>>("qubits_metric");
+    if (auto_layout) {
+      if (!parameters.keyExists<int>("metric_precision")) {
+        return false;
+      }
+      layout = layout_quantum_decoder(plan_quantum_decoder(
+          num_timesteps, alphabet_size, parameters.get<int>("metric_precision"), 0, compaction));
+    }
 
     //////////////////////////////////////////////////////////////////////////////////////
 
     //U prime unitary parameters
-    qubits_metric = {};
+    qubits_metric = layout.qubits_metric;
     if (parameters.keyExists<std::vector<int>>("qubits_metric")) {
-      qubits_metric = parameters.get<std::vector<int>>("qubits_metric");
+      qubits_metric = timestep_register("qubits_metric");
     }
     int metric_letter_precision = (int)qubits_metric.size() / num_timesteps;
 
-    qubits_string = {};
+    qubits_string = layout.qubits_string;
     if (parameters.keyExists<std::vector<int>>("qubits_string")) {
-      qubits_string = parameters.get<std::vector<int>>("qubits_string");
+      qubits_string = timestep_register("qubits_string");
     }
     int num_qubits_per_letter = (int)qubits_string.size() / num_timesteps;
     assert(num_qubits_per_letter >= std::log2((float)alphabet_size));
 
+    // Registers sized by the string length, given explicitly for the original table, are cut to the pruned
+    // table's plan. A register too small for it cannot be used.
+    const ResourcePlan timestep_plan = plan_quantum_decoder(num_timesteps, alphabet_size, metric_letter_precision,
+                                                            num_qubits_per_letter, compaction);
+    auto planned_register = [&](const std::vector<int> &layout_qubits, const std::string &name, int size) {
+      if (!parameters.keyExists<std::vector<int>>(name)) {
+        return layout_qubits;
+      }
+      std::vector<int> qubits = parameters.get<std::vector<int>>(name);
+      if (pruned_ && (int)qubits.size() > size) {
+        qubits.resize(size);
+      }
+      return qubits;
+    };
+
     //////////////////////////////////////////////////////////////////////////////////////
 
     //Parameters for comparator oracle in exponential search
     BestScore = parameters.get_or_default("BestScore", 0);
 
-    qubits_best_score = {};
-    if (parameters.keyExists<std::vector<int>>("qubits_best_score")) {
-      qubits_best_score = parameters.get<std::vector<int>>("qubits_best_score");
-    }
+    qubits_best_score = planned_register(layout.qubits_best_score, "qubits_best_score",
+                                         timestep_plan.beam_metric_precision);
     int metric_beam_precision = qubits_best_score.size();
 
     //////////////////////////////////////////////////////////////////////////////////////
 
     //Parameters for adder
-    qubits_total_metric_buffer = {};
-    if (parameters.keyExists<std::vector<int>>("qubits_total_metric_buffer")) {
-      qubits_total_metric_buffer =
-          parameters.get<std::vector<int>>("qubits_total_metric_buffer");
-    }
+    qubits_total_metric_buffer = planned_register(
+        layout.qubits_total_metric_buffer, "qubits_total_metric_buffer",
+        timestep_plan.string_metric_precision - metric_letter_precision);
 
     //////////////////////////////////////////////////////////////////////////////////////
 
@@ -72,62 +292,86 @@ namespace qristal {
     //////////////////////////////////////////////////////////////////////////////////////
 
     // Parameters for decoder kernel
-    if (!parameters.keyExists<std::vector<int>>("qubits_init_null")) {
+    qubits_init_null = layout.qubits_init_null;
+    if (parameters.keyExists<std::vector<int>>("qubits_init_null")) {
+      qubits_init_null = timestep_register("qubits_init_null");
+    } else if (!auto_layout) {
       return false;
     }
-    qubits_init_null = parameters.get<std::vector<int>>("qubits_init_null");
     assert((int)qubits_init_null.size() == num_timesteps);
 
-    if (!parameters.keyExists<std::vector<int>>("qubits_init_repeat")) {
+    qubits_init_repeat = layout.qubits_init_repeat;
+    if (parameters.keyExists<std::vector<int>>("qubits_init_repeat")) {
+      qubits_init_repeat = timestep_register("qubits_init_repeat");
+    } else if (!auto_layout) {
       return false;
     }
-    qubits_init_repeat = parameters.get<std::vector<int>>("qubits_init_repeat");
     assert((int)qubits_init_repeat.size() == num_timesteps);
 
-    qubits_ancilla_pool = {};
+    qubits_ancilla_pool = layout.qubits_ancilla_pool;
     if (parameters.keyExists<std::vector<int>>("qubits_ancilla_pool"))
     {
       qubits_ancilla_pool = parameters.get<std::vector<int>>("qubits_ancilla_pool");
     }
 
-    if (!parameters.keyExists<std::vector<int>>("qubits_superfluous_flags"))
+    qubits_superfluous_flags = layout.qubits_superfluous_flags;
+    if (parameters.keyExists<std::vector<int>>("qubits_superfluous_flags"))
+    {
+      qubits_superfluous_flags = timestep_register("qubits_superfluous_flags");
+    }
+    else if (!auto_layout)
     {
       return false;
     }
-    qubits_superfluous_flags = parameters.get<std::vector<int>>("qubits_superfluous_flags");
     assert((int)qubits_superfluous_flags.size() == num_timesteps);
 
-    qubits_beam_metric = {};
-    if (parameters.keyExists<std::vector<int>>("qubits_beam_metric"))
-    {
-      qubits_beam_metric = parameters.get<std::vector<int>>("qubits_beam_metric");
+    // Only plan the resources of the decode, without building or running any circuit
+    dry_run = parameters.get_or_default("dry_run", false);
+
+    qubits_beam_metric = planned_register(layout.qubits_beam_metric, "qubits_beam_metric",
+                                          timestep_plan.beam_metric_precision);
+    if (pruned_ && ((int)qubits_best_score.size() != timestep_plan.beam_metric_precision ||
+                    (int)qubits_beam_metric.size() != timestep_plan.beam_metric_precision ||
+                    (int)qubits_total_metric_buffer.size() !=
+                        timestep_plan.string_metric_precision - metric_letter_precision)) {
+      return false;
     }
     assert((int)qubits_beam_metric.size() == metric_beam_precision);
 
     //////////////////////////////////////////////////////////////////////////////////////
 
-    //Initialize qpu accelerator
+    //Initialize qpu accelerator: an accelerator instance is used as given, otherwise every thread
+    //executing the decoder gets its own, from the accelerator_pool given or from a pool of the named
+    //qpu owned by the decoder
     qpu_ = nullptr;
-    if (parameters.stringExists("qpu")) {
-      static auto acc =
-          xacc::getAccelerator(parameters.getString("qpu"), {{"shots", 1}});
-      qpu_ = acc.get();
-    } else if (parameters.pointerLikeExists<xacc::Accelerator>("qpu")) {
+    accelerator_pool_ = nullptr;
+    owned_accelerator_pool_.reset();
+    if (parameters.pointerLikeExists<xacc::Accelerator>("qpu")) {
       qpu_ = parameters.getPointerLike<xacc::Accelerator>("qpu");
+    } else if (parameters.pointerLikeExists<AcceleratorPool>("accelerator_pool")) {
+      accelerator_pool_ = parameters.getPointerLike<AcceleratorPool>("accelerator_pool");
+    } else {
+      // Default to qpp if none provided
+      const std::string name = parameters.stringExists("qpu") ? parameters.getString("qpu") : "qpp";
+      owned_accelerator_pool_ = std::make_shared<AcceleratorPool>(name, xacc::HeterogeneousMap{{"shots", 1}});
+      accelerator_pool_ = owned_accelerator_pool_.get();
     }
 
-    if (!qpu_) {
-      static auto qpp = xacc::getAccelerator("qpp", {{"shots", 1}});
-      // Default to qpp if none provided
-      qpu_ = qpp.get();
+    // Number of state preparation circuits (and layout templates) kept across executions, process-wide;
+    // 0 disables the caches
+    if (parameters.keyExists<int>("state_prep_cache_size")) {
+      const int capacity = std::max(0, parameters.get<int>("state_prep_cache_size"));
+      state_prep_cache().set_capacity(capacity);
+      state_prep_template_cache().set_capacity(capacity);
     }
 
     return true;
-  } //QuantumDecoder::initialize
+  } //QuantumDecoder::initialize_table
 
   /////////////////////////////////////////////////////////////////////////////////////////////
 
   const std::vector<std::string> QuantumDecoder::requiredParameters() const {
+    // The qubit registers and iteration may instead be laid out automatically, from metric_precision
     return {"probability_table", "iteration", "qubits_metric", "qubits_string",
             "method", "BestScore", "qubits_beam_metric", "qubits_superfluous_flags",
             "qubits_init_null", "qubits_init_repeat",
@@ -138,6 +382,25 @@ namespace qristal {
 
   void QuantumDecoder::execute(
       const std::shared_ptr<xacc::AcceleratorBuffer> buffer) const {
+
+    if (!probability_tables.empty()) {
+      execute_batch(buffer);
+      return;
+    }
+
+    // This thread's accelerator, held exclusively until the decode ends unless threads have their own
+    xacc::Accelerator *qpu = accelerator();
+    std::unique_lock<std::mutex> exclusive;
+    if (accelerator_pool_) {
+      exclusive = accelerator_pool_->exclusive();
+    }
+
+    if (pruned_) {
+      buffer->addExtraInfo("blanks_pruned", pruned_->nb_blanks_pruned);
+      buffer->addExtraInfo("repeats_merged", pruned_->nb_repeats_merged);
+      buffer->addExtraInfo("discarded_probability", pruned_->discarded_probability);
+    }
+
     auto gateRegistry = xacc::getService<xacc::IRProvider>("quantum");
 
     // qubits_next_letter and qubits_next_metric required at the same time
@@ -146,26 +409,61 @@ namespace qristal {
     int L = probability_table.size();
     int S = qubits_string.size()/L;
     int ml = qubits_metric.size()/L; // letter metric precision
-    int ms = std::round(0.49999 + std::log2(1 + L*(std::pow(2,ml) - 1))); // string metric precision
-    int p = ms*(ms+1)/2; // number of precision qubits needed for ae for metrics
-    int mb = std::round(0.49999 + std::log2(1 + std::pow((int)probability_table[0].size(), L)*(std::pow(2,ms) - 1))); // beam metric precision
+    const ResourcePlan plan = plan_quantum_decoder(L, probability_table[0].size(), ml, S, compaction);
+    int ms = plan.string_metric_precision; // string metric precision
+    int mb = plan.beam_metric_precision; // beam metric precision
+
+    // Report the plan instead of decoding
+    if (dry_run) {
+      buffer->addExtraInfo("plan_num_qubits", plan.num_qubits);
+      buffer->addExtraInfo("plan_num_ancilla", plan.num_ancilla);
+      buffer->addExtraInfo("plan_iteration", iteration);
+      buffer->addExtraInfo("plan_ancilla_ok", (int)((int)qubits_ancilla_pool.size() >= plan.num_ancilla));
+      buffer->addExtraInfo("plan_registers_ok", (int)((int)qubits_beam_metric.size() == mb &&
+                                                      (int)qubits_best_score.size() == mb &&
+                                                      (int)qubits_total_metric_buffer.size() == ms - ml));
+      for (const auto &[block, cost] : plan.blocks) {
+        buffer->addExtraInfo("plan_" + block + "_depth", (int)cost.depth);
+        for (const auto &[gate, count] : cost.gates) {
+          buffer->addExtraInfo("plan_" + block + "_" + gate, (int)count);
+        }
+      }
+      return;
+    }
 
     std::cout << "Welcome to the Quantum Decoder!\n";
     std::cout << "----------------------------------------------------------------\n";
     std::cout << "Finding the most likely beam for string length " << L << "and " << probability_table[0].size() << " symbols.\n";
     std::cout << "----------------------------------------------------------------\n";
 
-    int required_num_ancilla = std::max({ml+S, ms-ml, 4+5*ms+2*p+ms+S+L*S+L, 4+p+mb+2*ms+L*S+L});
-    if (qubits_ancilla_pool.size() < required_num_ancilla) {
+    // With reuse_ancilla, a pool smaller than the plan's will do if the remapped circuits fit in it: they are
+    // built on the pool extended by virtual qubits past every register, which the remap must leave unused
+    std::vector<int> ancilla_pool = qubits_ancilla_pool;
+    int first_virtual_qubit = -1;
+    if ((int)ancilla_pool.size() < plan.num_ancilla) {
+      if (!reuse_ancilla) {
         xacc::error("Not enough ancilla provided.");
+      }
+      int next = 0;
+      for (const auto &qubits : {qubits_metric, qubits_string, qubits_init_null, qubits_init_repeat,
+                                 qubits_superfluous_flags, qubits_total_metric_buffer, qubits_beam_metric,
+                                 qubits_best_score, qubits_ancilla_pool}) {
+        for (int qubit : qubits) {
+          next = std::max(next, qubit + 1);
+        }
+      }
+      first_virtual_qubit = next;
+      while ((int)ancilla_pool.size() < plan.num_ancilla) {
+        ancilla_pool.push_back(next++);
+      }
     }
 
     std::cout << "Beginning decoder algorithm.\n";
     for (int i = 0; i < S; i++) {
-    qubits_next_letter.push_back(qubits_ancilla_pool[i]);
+    qubits_next_letter.push_back(ancilla_pool[i]);
     }
     for (int i = 0; i < ml; i++) {
-    qubits_next_metric.push_back(qubits_ancilla_pool[S+i]);
+    qubits_next_metric.push_back(ancilla_pool[S+i]);
     }
 
     // Take the logarithm of the probability table
@@ -181,42 +479,23 @@ namespace qristal {
   //   probability_table = log_prob_table;
 
     //State preparation: Prepare initial state using unitaries for the exponential search.
-    std::function<std::shared_ptr<xacc::CompositeInstruction>(
+
+    // Only the W prime rotations depend on the probability table; the repeat flags, U prime, Q prime and the
+    // adder chain depend only on the register layout and the number of iterations. Those blocks are built once
+    // per layout into a template, so a new table with the same shape only expands W prime and the kernel.
+    std::function<std::shared_ptr<const StatePrepTemplate>(
         std::vector<int>, std::vector<int>, std::vector<int>, std::vector<int>,
         std::vector<int>)>
-        state_prep_ = [&](std::vector<int> qubits_string,
-                          std::vector<int> qubits_metric,
-                          std::vector<int> qubits_next_letter,
-                          std::vector<int> qubits_next_metric,
-                          std::vector<int> qubits_total_metric_buffer) {
-          // Initialize state preparation circuit
-          auto gateRegistry = xacc::getService<xacc::IRProvider>("quantum");
-          auto state_prep = gateRegistry->createComposite("state_prep");
-
-          /////////////////////////////////////////////////////////////////////////////////////////////
+        state_prep_template_ = [&](std::vector<int> qubits_string,
+                                   std::vector<int> qubits_metric,
+                                   std::vector<int> qubits_next_letter,
+                                   std::vector<int> qubits_next_metric,
+                                   std::vector<int> qubits_total_metric_buffer) {
+          auto state_prep_template = std::make_shared<StatePrepTemplate>();
 
           // Loop over rows of the probability table (i.e. over string length)
           for (int it = 0; it < iteration; it++) {
-            // Initialize W prime unitary
-            auto w_prime = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
-                xacc::getService<xacc::Instruction>("WPrime"));
-
-            // Merge qubit register for W prime unitary into a heterogenous map
-            xacc::HeterogeneousMap w_map = {
-                {"iteration", it},
-                {"qubits_next_letter", qubits_next_letter},
-                {"qubits_next_metric", qubits_next_metric},
-                {"probability_table", probability_table},
-                {"qubits_init_null", qubits_init_null},
-                {"flag_integer", 0}};
-
-            // Add qubit register to W prime
-            w_prime->expand(w_map);
-
-            // Add W prime unitary to state preparation circuit
-            state_prep->addInstruction(w_prime);
-
-            /////////////////////////////////////////////////////////////////////////////////////////////
+            std::vector<std::shared_ptr<xacc::CompositeInstruction>> round;
 
             // Initialize repetition flags
             if (it > 0) {
@@ -230,7 +509,7 @@ namespace qristal {
                   {"qubits_init_repeat", qubits_init_repeat}};
               init_repeat->expand(rep_map);
               // Add marking of repeat symbols to state preparation circuit
-              state_prep->addInstruction(init_repeat);
+              round.push_back(init_repeat);
             }
 
             /////////////////////////////////////////////////////////////////////////////////////////////
@@ -251,7 +530,7 @@ namespace qristal {
             u_prime->expand(u_map);
 
             // Add U prime unitary to state preparation circuit
-            state_prep->addInstruction(u_prime);
+            round.push_back(u_prime);
 
             /////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -271,7 +550,9 @@ namespace qristal {
             q_prime->expand(q_map);
 
             // Add Q prime unitary to state preparation circuit
-            state_prep->addInstruction(q_prime);
+            round.push_back(q_prime);
+
+            state_prep_template->rounds.push_back(round);
           } // Loop over string length
 
           /////////////////////////////////////////////////////////////////////////////////////////////
@@ -282,7 +563,7 @@ namespace qristal {
                       .size(); // Size of the qubits_next_metric is constant and
                                // fixed at the initizalization of the program.
           int c_in =
-              qubits_ancilla_pool[0]; // qubits_ancilla_adder[0]; //Carry over
+              ancilla_pool[0]; // qubits_ancilla_adder[0]; //Carry over
           std::vector<int> total_metric;
 
           // Insert first iteration's qubits into total_metric and use it in the
@@ -306,7 +587,7 @@ namespace qristal {
 
             for (int i = 0; i < total_metric.size() - 1 - m; i++) {
               metrics.push_back(
-                  qubits_ancilla_pool
+                  ancilla_pool
                       [i + 1]); // metrics.push_back(qubits_ancilla_oracle[i]);
             }
 
@@ -320,14 +601,67 @@ namespace qristal {
             assert(expand_ok);
 
             // Add total metric to state preparation circuit
+            state_prep_template->adders.push_back(adder);
+          }
+          return std::shared_ptr<const StatePrepTemplate>(state_prep_template);
+        };
+
+    std::function<std::shared_ptr<xacc::CompositeInstruction>(
+        const StatePrepTemplate &, std::vector<int>, std::vector<int>, std::vector<int>,
+        std::vector<int>)>
+        state_prep_ = [&](const StatePrepTemplate &state_prep_template,
+                          std::vector<int> qubits_string,
+                          std::vector<int> qubits_metric,
+                          std::vector<int> qubits_next_letter,
+                          std::vector<int> qubits_next_metric) {
+          // Initialize state preparation circuit
+          auto gateRegistry = xacc::getService<xacc::IRProvider>("quantum");
+          auto state_prep = gateRegistry->createComposite("metric_state_prep");
+
+          /////////////////////////////////////////////////////////////////////////////////////////////
+
+          // Merge qubit register for W prime unitary into a heterogenous map. W prime takes the table as
+          // nested vectors, so it is converted once here and shared by every iteration.
+          xacc::HeterogeneousMap w_map = {
+              {"iteration", 0},
+              {"qubits_next_letter", qubits_next_letter},
+              {"qubits_next_metric", qubits_next_metric},
+              {"probability_table", probability_table.to_rows()},
+              {"qubits_init_null", qubits_init_null},
+              {"flag_integer", 0}};
+
+          // Loop over rows of the probability table (i.e. over string length)
+          for (int it = 0; it < iteration; it++) {
+            // Initialize W prime unitary
+            auto w_prime = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+                xacc::getService<xacc::Instruction>("WPrime"));
+
+            // Add qubit register to W prime
+            w_map.insert("iteration", it);
+            w_prime->expand(w_map);
+
+            // Add W prime unitary to state preparation circuit
+            state_prep->addInstruction(w_prime);
+
+            // Followed by the table-independent blocks of this round
+            for (const auto &block : state_prep_template.rounds[it]) {
+              state_prep->addInstruction(block);
+            }
+          } // Loop over string length
+
+          // Sum the individual metrics into the total metric
+          for (const auto &adder : state_prep_template.adders) {
             state_prep->addInstruction(adder);
           }
 
           /////////////////////////////////////////////////////////////////////////////////////////////
 
-          // Now we apply the decoder kernel to form beam equivalence classes
-          std::shared_ptr<xacc::CompositeInstruction> state_prep_clone =
-              xacc::ir::asComposite(state_prep->clone());
+          // Now we apply the decoder kernel to form beam equivalence classes. The kernel's adder runs the
+          // metric state preparation again, sharing it: it is left unchanged, and the kernel follows it in a
+          // new composite.
+          std::shared_ptr<xacc::CompositeInstruction> metric_state_prep = state_prep;
+          state_prep = gateRegistry->createComposite("state_prep");
+          state_prep->addInstruction(metric_state_prep);
 
           auto decoder_kernel =
               std::dynamic_pointer_cast<xacc::CompositeInstruction>(
@@ -340,64 +674,113 @@ namespace qristal {
                {"qubits_init_repeat", qubits_init_repeat},
                {"qubits_superfluous_flags", qubits_superfluous_flags},
                {"qubits_beam_metric", qubits_beam_metric},
-               {"qubits_ancilla_pool", qubits_ancilla_pool},
-               {"metric_state_prep", state_prep_clone}});
+               {"qubits_ancilla_pool", ancilla_pool},
+               {"metric_state_prep", metric_state_prep},
+               {"compaction", compaction}});
           assert(expand_ok);
           state_prep->addInstruction(decoder_kernel);
+          if (reuse_ancilla) {
+            // The oracle's flag and carry qubits must still be |0> after the state preparation
+            return remap_ancillas(state_prep, ancilla_pool,
+                                  {ancilla_pool[0], ancilla_pool[1]});
+          }
           return state_prep;
         };
-    auto state_prep_circ =
-        state_prep_(qubits_string, qubits_metric, qubits_next_letter,
-                    qubits_next_metric, qubits_total_metric_buffer);
+
+    // The state preparation circuit depends only on the register layout, the number of iterations and the
+    // probability table (which also fixes the metric precision) and the kernel's compaction mode, so repeated
+    // decodes reuse a cached circuit.
+    // The table is part of the key in full, so different tables never share a circuit.
+    std::string layout_key;
+    append_key(layout_key, std::vector<int>{iteration, ml});
+    for (const auto &qubits : {qubits_string, qubits_metric, qubits_next_letter, qubits_next_metric,
+                               qubits_total_metric_buffer, qubits_init_null, qubits_init_repeat,
+                               qubits_superfluous_flags, qubits_beam_metric, ancilla_pool}) {
+      append_key(layout_key, qubits);
+    }
+    std::string state_prep_key = layout_key;
+    append_key(state_prep_key, std::vector<char>(compaction.begin(), compaction.end()));
+    append_key(state_prep_key, std::vector<char>{reuse_ancilla});
+    append_key(state_prep_key, std::vector<std::size_t>{probability_table.nb_timesteps(), probability_table.nb_symbols()});
+    state_prep_key.append(reinterpret_cast<const char *>(probability_table.data()),
+                          probability_table.nb_timesteps() * probability_table.nb_symbols() * sizeof(float));
+    bool template_cached = true; // not needed, on a circuit cache hit
+    auto [state_prep_circ, state_prep_cached] = state_prep_cache().get_or_create(state_prep_key, [&] {
+      // A new table: reuse the table-independent blocks of a circuit of the same layout
+      auto [state_prep_template, hit] = state_prep_template_cache().get_or_create(layout_key, [&] {
+        return state_prep_template_(qubits_string, qubits_metric, qubits_next_letter,
+                                    qubits_next_metric, qubits_total_metric_buffer);
+      });
+      template_cached = hit;
+      return state_prep_(*state_prep_template, qubits_string, qubits_metric, qubits_next_letter,
+                         qubits_next_metric);
+    });
+    buffer->addExtraInfo("state_prep_template_hit", (int)template_cached);
+    buffer->addExtraInfo("state_prep_cache_hit", (int)state_prep_cached);
+    buffer->addExtraInfo("state_prep_cache_hits", (int)state_prep_cache().hits());
+    buffer->addExtraInfo("state_prep_cache_misses", (int)state_prep_cache().misses());
 
     /////////////////////////////////////////////////////////////////////////////////////////////
 
     // Comparator oracle
+    // The comparator core (phase kickback around CompareGT) depends only on the register layout, so it is
+    // built once per layout; each score only adds the X layer loading it into qubits_best_score. Oracles
+    // are memoised per score, so exponential search gets them almost for free after the first request.
+    const int qubit_flag = ancilla_pool[0];
+    const int c_in = ancilla_pool[1];
+    std::string oracle_layout_key;
+    for (const auto &qubits : {qubits_beam_metric, qubits_best_score, std::vector<int>{qubit_flag, c_in}}) {
+      append_key(oracle_layout_key, qubits);
+    }
+    auto comparator = comparator_cache().get_or_create(oracle_layout_key, [&] {
+      auto comparator = gateRegistry->createComposite("comparator");
+
+      // Phase kickback method
+      comparator->addInstruction(
+          gateRegistry->createInstruction("X", qubit_flag));
+      comparator->addInstruction(
+          gateRegistry->createInstruction("H", qubit_flag));
+
+      auto comp = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+          xacc::getService<xacc::Instruction>("CompareGT"));
+      xacc::HeterogeneousMap options{{"qubits_a", qubits_beam_metric},
+                                     {"qubits_b", qubits_best_score},
+                                     {"qubit_flag", qubit_flag},
+                                     {"qubit_ancilla", c_in},
+                                     {"is_LSB", true}};
+      const bool expand_ok = comp->expand(options);
+      assert(expand_ok);
+      comparator->addInstruction(comp);
+
+      comparator->addInstruction(
+          gateRegistry->createInstruction("H", qubit_flag));
+      comparator->addInstruction(
+          gateRegistry->createInstruction("X", qubit_flag));
+      return comparator;
+    }).first;
+
     std::function<std::shared_ptr<xacc::CompositeInstruction>(int)> oracle_ =
         [&](int BestScore) {
-          int qubit_flag = qubits_ancilla_pool[0];
-          int c_in = qubits_ancilla_pool[1];
-          int n = qubits_best_score.size();
-
-          // Initialize comparator oracle circuit
-          auto oracle = gateRegistry->createComposite("oracle");
-
-          // Encode BestScore as a bitstring
-          std::string BestScore_binary =
-              std::bitset<sizeof(BestScore)>(BestScore).to_string();
-          std::string BestScore_binary_n = BestScore_binary.substr(
-              BestScore_binary.size() < n ? 0 : BestScore_binary.size() - n);
-
-          // Prepare |BestScore>
-          for (int i = 0; i < n; i++) {
-            if (BestScore_binary_n[i] == '1') {
-              oracle->addInstruction(
-                  gateRegistry->createInstruction("X", qubits_best_score[i]));
+          std::string oracle_key = oracle_layout_key;
+          append_key(oracle_key, std::vector<int>{BestScore});
+          return oracle_cache().get_or_create(oracle_key, [&] {
+            int n = qubits_best_score.size();
+
+            // Initialize comparator oracle circuit
+            auto oracle = gateRegistry->createComposite("oracle");
+
+            // Prepare |BestScore>, most significant bit on qubits_best_score[0]
+            for (int i = 0; i < n; i++) {
+              const int bit = n - 1 - i;
+              if (bit < 31 && ((BestScore >> bit) & 1)) {
+                oracle->addInstruction(
+                    gateRegistry->createInstruction("X", qubits_best_score[i]));
+              }
             }
-          }
-          // Phase kickback method
-          oracle->addInstruction(
-              gateRegistry->createInstruction("X", qubit_flag));
-          oracle->addInstruction(
-              gateRegistry->createInstruction("H", qubit_flag));
-
-          auto comp = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
-              xacc::getService<xacc::Instruction>("CompareGT"));
-          xacc::HeterogeneousMap options{{"qubits_a", qubits_beam_metric},
-                                         {"qubits_b", qubits_best_score},
-                                         {"qubit_flag", qubit_flag},
-                                         {"qubit_ancilla", c_in},
-                                         {"is_LSB", true}};
-          const bool expand_ok = comp->expand(options);
-          assert(expand_ok);
-          oracle->addInstruction(comp);
-
-          oracle->addInstruction(
-              gateRegistry->createInstruction("H", qubit_flag));
-          oracle->addInstruction(
-              gateRegistry->createInstruction("X", qubit_flag));
+            oracle->addInstruction(comparator);
 
-          return oracle;
+            return oracle;
+          }).first;
         };
 
     /////////////////////////////////////////////////////////////////////////////////////////////
@@ -428,32 +811,116 @@ namespace qristal {
     /////////////////////////////////////////////////////////////////////////////////////////////
 
     int current_best_score = BestScore;
-    int max_best_score = current_best_score;
+
+    // Classical warm start: search only for beams better than one a classical decode finds at once, rather
+    // than spending the first trials' Grover rounds rediscovering it. The beam is the best string until a
+    // trial beats it.
     std::string best_string;
-    int total_num_qubits = 3*L + 2*mb + ms - ml + S*L + ml*L + qubits_ancilla_pool.size();
+    int best_beam_length = 0;
+    if (warm_start != "none") {
+      const CtcReference reference(probability_table);
+      const ScoredBeam beam = warm_start == "greedy" ? reference.best_path()
+                                                     : reference.top_beams(1, warm_start_beam_width).front();
+      const int warm_start_score = beam_metric_lower_bound(probability_table, beam.symbols, plan);
+      if (warm_start_score > current_best_score) {
+        current_best_score = warm_start_score;
+        best_string = string_register_bits(beam.symbols, L, S);
+        best_beam_length = std::min<int>(beam.symbols.size(), L);
+      }
+      buffer->addExtraInfo("warm_start_score", warm_start_score);
+    }
+
+    int max_best_score = current_best_score;
+    int total_num_qubits = 3*L + 2*mb + ms - ml + S*L + ml*L + ancilla_pool.size();
+    if (reuse_ancilla) {
+      // Only as many qubits as the remapped circuits reach
+      std::set<std::size_t> used = state_prep_circ->uniqueBits();
+      const std::set<std::size_t> oracle_bits = comparator->uniqueBits();
+      used.insert(oracle_bits.begin(), oracle_bits.end());
+      for (const auto &qubits : {qubits_string, qubits_beam_metric}) {
+        used.insert(qubits.begin(), qubits.end());
+      }
+      total_num_qubits = *used.rbegin() + 1;
+      if (first_virtual_qubit >= 0 && total_num_qubits > first_virtual_qubit) {
+        xacc::error("Not enough ancilla provided, even with reuse_ancilla.");
+      }
+      buffer->addExtraInfo("ancilla_pool_used", (int)std::count_if(
+          ancilla_pool.begin(), ancilla_pool.end(), [&](int q) { return used.count(q); }));
+    }
+    buffer->addExtraInfo("total_num_qubits", total_num_qubits);
 
     std::cout<< "Total number qubits = " << total_num_qubits << "\n";
 
+    // Oracle queries are counted as exponential search requests oracles, whatever the method
+    int oracle_queries = 0;
+    double search_seconds = 0;
+    std::function<std::shared_ptr<xacc::CompositeInstruction>(int)> counted_oracle = [&](int score) {
+      oracle_queries++;
+      return oracle_(score);
+    };
+    std::function<std::shared_ptr<xacc::CompositeInstruction>(
+        int, int, std::vector<int>, int, std::vector<int>, std::vector<int>)>
+        comparator_oracle = [&](int score, int, std::vector<int>, int, std::vector<int>, std::vector<int>) {
+          return counted_oracle(score);
+        };
+
+    // The superfluous flags are measured after the string register, to tell the beam from the symbols
+    // compaction leaves behind it
+    std::vector<int> qubits_measured = qubits_string;
+    qubits_measured.insert(qubits_measured.end(), qubits_superfluous_flags.begin(), qubits_superfluous_flags.end());
+
+    const auto start_time = std::chrono::steady_clock::now();
+    std::string stop_reason = "trials";
+    int trials_run = 0;
+    int trials_without_improvement = 0;
     for (int runCount = 0; runCount < N_TRIALS; ++runCount) {
+      // Stopping policies, checked before every trial
+      if (target_score >= 0 && current_best_score >= target_score) {
+        stop_reason = "target_score";
+        break;
+      }
+      if (patience > 0 && trials_without_improvement >= patience) {
+        stop_reason = "patience";
+        break;
+      }
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+      if (time_budget > 0 && elapsed.count() >= time_budget) {
+        stop_reason = "time_budget";
+        break;
+      }
+
       std::cout << "Decoder iteration: " << runCount + 1
                 << ", initial best score: " << current_best_score << std::endl;
 
       // for (auto bit : qubits_beam_metric) {
       //     std::cout << "beam metric bit " << bit << "\n";
       // }
-      auto exp_search_algo = xacc::getAlgorithm(
-        "exponential-search", {{"method", "canonical"},
-                               {"state_preparation_circuit", state_prep_circ},
-                               {"oracle_circuit", oracle_},
-                               {"best_score", current_best_score},
-                               {"f_score", f_score},
-                               {"total_num_qubits", total_num_qubits},
-                               {"qubits_string", qubits_string},
-                               {"total_metric", qubits_beam_metric},
-                               {"qpu", qpu_}});
+      xacc::HeterogeneousMap search_options{{"method", method},
+                                            {"state_preparation_circuit", state_prep_circ},
+                                            {"oracle_circuit", counted_oracle},
+                                            {"best_score", current_best_score},
+                                            {"f_score", f_score},
+                                            {"total_num_qubits", total_num_qubits},
+                                            {"qubits_string", qubits_measured},
+                                            {"total_metric", qubits_beam_metric},
+                                            {"qpu", qpu}};
+      if (method != "canonical") {
+        // The amplitude estimation methods build their own oracles for each trial score
+        search_options.insert("comparator_oracle", comparator_oracle);
+        search_options.insert("qubit_flag", qubit_flag);
+        search_options.insert("qubits_best_score", qubits_best_score);
+        search_options.insert("qubits_ancilla_oracle", std::vector<int>{c_in});
+        for (const auto &[key, value] : qae_options) {
+          search_options.insert(key, value);
+        }
+      }
+      auto exp_search_algo = xacc::getAlgorithm("exponential-search", search_options);
 
       auto buffer = xacc::qalloc(total_num_qubits);
+      const auto search_start = std::chrono::steady_clock::now();
       exp_search_algo->execute(buffer);
+      search_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - search_start).count();
+      trials_run++;
       auto info = buffer->getInformation();
       //    std::cout << buffer->toString() << std::endl;
       int bs = info.at("best-score").as<int>();
@@ -464,28 +931,88 @@ namespace qristal {
 
       if (current_best_score > previous_best_score) {
         std::cout << "New best score: " << current_best_score << std::endl;
-        best_string = info.at("best-string").as<std::string>();
+        const std::string measured = info.at("best-string").as<std::string>();
+        best_string = measured.substr(0, L*S);
+        best_beam_length = std::count(measured.begin() + std::min<std::size_t>(measured.size(), L*S),
+                                      measured.end(), '0');
+        trials_without_improvement = 0;
+      } else {
+        trials_without_improvement++;
       }
       if (current_best_score > max_best_score)
         max_best_score = current_best_score;
-      // if (current_best_score <= previous_best_score && previous_best_score > 0)
-      // {
-      //   std::cout << std::endl;
-      //   std::cout << "--------------------------------------------------" <<
-      //   std::endl; std::cout << "Maximum score achieved at decoder iteration "
-      //   << runCount
-      //             << ", with score: " << previous_best_score
-      //             << ", and string: " << best_string << std::endl;
-      //   std::cout <<  "Exiting decoder." << std::endl;
-      //   std::cout << "--------------------------------------------------" <<
-      //   std::endl; std::cout << std::endl; break;
-      // }
       std::cout << "--------------------------------------------------"
                 << std::endl;
       std::cout << std::endl;
     }
     assert(max_best_score >= BestScore);
 
+    if (stop_reason != "trials") {
+      std::cout << "Stopped by " << stop_reason << " after " << trials_run << " of " << N_TRIALS
+                << " decoder iterations, with score: " << max_best_score << std::endl;
+    }
+    buffer->addExtraInfo("stop_reason", stop_reason);
+    buffer->addExtraInfo("trials_run", trials_run);
+    buffer->addExtraInfo("trials_saved", N_TRIALS - trials_run);
+    buffer->addExtraInfo("oracle_queries", oracle_queries);
+    buffer->addExtraInfo("search_seconds", search_seconds);
+    buffer->addExtraInfo("best_score", max_best_score);
+    buffer->addExtraInfo("best_string", best_string);
+    buffer->addExtraInfo("best_beam_length", best_beam_length);
+
   } // QuantumDecoder::execute
 
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  void QuantumDecoder::execute_batch(const std::shared_ptr<xacc::AcceleratorBuffer> buffer) const {
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t nb_utterances = probability_tables.size();
+
+    // Decode every table with its own decoder, grouped by shape so that each shape builds its state
+    // preparation template and comparator once
+    std::vector<std::shared_ptr<xacc::AcceleratorBuffer>> results(nb_utterances);
+    const std::vector<std::size_t> order = batch_order(probability_tables);
+    auto decode = [&](std::size_t k) {
+      const std::size_t i = order[k];
+      xacc::HeterogeneousMap utterance = parameters_;
+      if (accelerator_pool_) {
+        utterance.insert("accelerator_pool", accelerator_pool_);
+      }
+      QuantumDecoder decoder;
+      if (!decoder.initialize_table(utterance, probability_tables[i])) {
+        throw std::runtime_error("Cannot decode probability table " + std::to_string(i) + " of the batch!\n");
+      }
+      results[i] = xacc::qalloc(buffer->size());
+      decoder.execute(results[i]);
+    };
+    if (accelerator_pool_ && !accelerator_pool_->shared()) {
+      // Each thread of the pool decodes on its own accelerator
+      default_thread_pool().parallel_for(nb_utterances, decode);
+    } else {
+      // A qpu given as an instance, or shared by the pool, runs one decode at a time
+      for (std::size_t k = 0; k < nb_utterances; k++) {
+        decode(k);
+      }
+    }
+
+    std::vector<std::string> best_strings;
+    std::vector<int> best_scores;
+    for (std::size_t i = 0; i < nb_utterances; i++) {
+      buffer->appendChild("utterance_" + std::to_string(i), results[i]);
+      auto info = results[i]->getInformation();
+      if (info.count("best_string")) {
+        best_strings.push_back(info.at("best_string").as<std::string>());
+        best_scores.push_back(info.at("best_score").as<int>());
+      }
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (!dry_run) {
+      buffer->addExtraInfo("best_strings", best_strings);
+      buffer->addExtraInfo("best_scores", best_scores);
+    }
+    buffer->addExtraInfo("nb_utterances", (int)nb_utterances);
+    buffer->addExtraInfo("batch_seconds", elapsed.count());
+    buffer->addExtraInfo("utterances_per_second", nb_utterances/elapsed.count());
+  } // QuantumDecoder::execute_batch
+
 }
@@ -0,0 +1,367 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/resource_plan.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace qristal {
+
+  namespace {
+
+    // Accumulates the gate counts and depth of a block as its gates are added in circuit order
+    class BlockCounter {
+
+      public:
+
+        void add(const std::string &gate, const std::vector<int> &qubits) {
+          std::size_t layer = 0;
+          for (int qubit : qubits) {
+            layer = std::max(layer, ready_[qubit]);
+          }
+          layer++;
+          for (int qubit : qubits) {
+            ready_[qubit] = layer;
+          }
+          cost_.gates[gate]++;
+          cost_.depth = std::max(cost_.depth, layer);
+        }
+
+        const BlockCost &cost() const { return cost_; }
+
+      private:
+
+        BlockCost cost_;
+        std::unordered_map<int, std::size_t> ready_; // first free layer per qubit
+    };
+
+    // Smallest B with 2^B >= n
+    int ceil_log2(int n) {
+      int bits = 0;
+      while ((1 << bits) < n) {
+        bits++;
+      }
+      return bits;
+    }
+
+    // Consecutive qubit indices from next, advancing it
+    std::vector<int> allocate(int &next, int size) {
+      std::vector<int> qubits(size);
+      for (int &qubit : qubits) {
+        qubit = next++;
+      }
+      return qubits;
+    }
+
+    std::vector<int> concat(std::vector<int> a, const std::vector<int> &b) {
+      a.insert(a.end(), b.begin(), b.end());
+      return a;
+    }
+
+    std::vector<int> slice(const std::vector<int> &qubits, int begin, int end) {
+      return std::vector<int>(qubits.begin() + begin, qubits.begin() + end);
+    }
+
+    // Compaction of the decoder kernel, gate for gate as DecoderKernel::expand adds it
+    BlockCost plan_compaction(int L, int S, const std::string &compaction) {
+      int next = 0;
+      const std::vector<int> string = allocate(next, L*S);
+      const std::vector<int> flags = allocate(next, L);
+      const std::vector<int> null = allocate(next, L);
+      const std::vector<int> repeat = allocate(next, L);
+      BlockCounter kernel;
+
+      if (compaction == "cascade") {
+        const int control_swap = next++;
+        for (int i = L - 1; i >= 0; i--) {
+          kernel.add("X", {flags[i]});
+          kernel.add("GeneralisedMCX", {null[i], repeat[i], flags[i]});
+          if (i == L - 1) {
+            continue;
+          }
+          kernel.add("CX", {flags[i], control_swap});
+          for (int j = i; j < L - 1; j++) {
+            kernel.add("ControlledSwap", concat({control_swap}, slice(string, j*S, (j + 2)*S)));
+            kernel.add("ControlledSwap", {control_swap, flags[j], flags[j + 1]});
+          }
+          kernel.add("X", {control_swap});
+          kernel.add("GeneralisedMCX", {null[i], repeat[i], control_swap});
+        }
+        return kernel.cost();
+      }
+
+      if (compaction != "network") {
+        throw std::runtime_error("Unknown compaction mode: " + compaction + "\n");
+      }
+      for (int i = 0; i < L; i++) {
+        kernel.add("X", {flags[i]});
+        kernel.add("GeneralisedMCX", {null[i], repeat[i], flags[i]});
+      }
+      const int B = ceil_log2(L);
+      if (B == 0) {
+        return kernel.cost();
+      }
+      const int s = (1 << B) - L;
+      std::vector<std::vector<int>> tags(L);
+      for (auto &tag : tags) {
+        tag = allocate(next, B);
+      }
+      const std::vector<int> carries = allocate(next, L/2);
+
+      // Prefix count of kept symbols
+      for (int b = 0; b < B; b++) {
+        if ((s >> b) & 1) {
+          kernel.add("X", {tags[0][b]});
+        }
+      }
+      for (int i = 1; i < L; i++) {
+        kernel.add("X", {tags[i][0]});
+        kernel.add("CX", {flags[i - 1], tags[i][0]});
+      }
+      auto add_tags = [&](const std::vector<int> &target, const std::vector<int> &source, int carry) {
+        auto majority = [&](int x, int y, int z) {
+          kernel.add("CX", {z, y});
+          kernel.add("CX", {z, x});
+          kernel.add("GeneralisedMCX", {x, y, z});
+        };
+        auto unmajority = [&](int x, int y, int z) {
+          kernel.add("GeneralisedMCX", {x, y, z});
+          kernel.add("CX", {z, x});
+          kernel.add("CX", {x, y});
+        };
+        majority(carry, target[0], source[0]);
+        for (int b = 1; b < B; b++) {
+          majority(source[b - 1], target[b], source[b]);
+        }
+        for (int b = B - 1; b > 0; b--) {
+          unmajority(source[b - 1], target[b], source[b]);
+        }
+        unmajority(carry, target[0], source[0]);
+      };
+      int stride = 1;
+      for (; stride < L; stride *= 2) {
+        for (int j = 2*stride - 1, n = 0; j < L; j += 2*stride, n++) {
+          add_tags(tags[j], tags[j - stride], carries[n]);
+        }
+      }
+      for (stride /= 2; stride >= 1; stride /= 2) {
+        for (int j = 3*stride - 1, n = 0; j < L; j += 2*stride, n++) {
+          add_tags(tags[j], tags[j - stride], carries[n]);
+        }
+      }
+
+      // Offsets of flagged symbols
+      for (int i = 0; i < L; i++) {
+        const int offset = L - 1 - i;
+        for (int t = 0; t < B; t++) {
+          if (!((offset >> t) & 1)) {
+            continue;
+          }
+          for (int u = B - 1; u >= t; u--) {
+            kernel.add("GeneralisedMCX", concat(concat({flags[i]}, slice(tags[i], t, u)), {tags[i][u]}));
+          }
+        }
+      }
+
+      // Routing
+      for (int b = 0; b < B; b++) {
+        for (int p = s; p < (1 << B); p++) {
+          if ((p >> b) & 1) {
+            continue;
+          }
+          const int i = p - s;
+          const int j = (p | (1 << b)) - s;
+          std::vector<int> qubits = {tags[i][b], flags[i], flags[j]};
+          qubits = concat(qubits, slice(string, i*S, (i + 1)*S));
+          qubits = concat(qubits, slice(string, j*S, (j + 1)*S));
+          qubits = concat(qubits, slice(tags[i], b + 1, B));
+          qubits = concat(qubits, slice(tags[j], b + 1, B));
+          kernel.add("ControlledSwap", qubits);
+        }
+      }
+      return kernel.cost();
+    }
+
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  int compaction_network_ancilla(int string_length) {
+    return string_length*ceil_log2(string_length) + string_length/2;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  ResourcePlan plan_quantum_decoder(int string_length, int alphabet_size, int metric_precision,
+                                    int nq_symbol, const std::string &compaction) {
+    if (string_length < 1 || alphabet_size < 2 || metric_precision < 1) {
+      throw std::runtime_error("A plan needs a string length, at least two symbols and a metric precision!\n");
+    }
+    const int L = string_length;
+    const int ml = metric_precision;
+    const int S = nq_symbol > 0 ? nq_symbol : ceil_log2(alphabet_size);
+
+    // Register sizes, as QuantumDecoder works them out
+    ResourcePlan plan;
+    plan.nq_symbol = S;
+    plan.metric_precision = ml;
+    const int ms = std::round(0.49999 + std::log2(1 + L*(std::pow(2,ml) - 1)));
+    const int p = ms*(ms+1)/2;
+    const int mb = std::round(0.49999 + std::log2(1 + std::pow(alphabet_size, L)*(std::pow(2,ms) - 1)));
+    plan.string_metric_precision = ms;
+    plan.ae_precision = p;
+    plan.beam_metric_precision = mb;
+    plan.string_length = L;
+    plan.alphabet_size = alphabet_size;
+
+    // The next letter and metric, then the adder chain's padding
+    plan.stage_ancilla["state_prep"] = std::max(ml+S, ms-ml);
+    plan.stage_ancilla["decoder_kernel"] = 4+5*ms+2*p+ms+S+L*S+L;
+    plan.stage_ancilla["oracle"] = 4+p+mb+2*ms+L*S+L;
+    if (compaction == "network") {
+      plan.stage_ancilla["decoder_kernel"] += compaction_network_ancilla(L);
+      plan.stage_ancilla["oracle"] += compaction_network_ancilla(L);
+    }
+    plan.num_ancilla = 0;
+    for (const auto &[stage, num_ancilla] : plan.stage_ancilla) {
+      plan.num_ancilla = std::max(plan.num_ancilla, num_ancilla);
+    }
+    plan.num_qubits = 3*L + 2*mb + ms - ml + S*L + ml*L + plan.num_ancilla;
+
+    // Blocks are costed on the automatic register layout
+    const DecoderLayout layout = layout_quantum_decoder(plan);
+    const std::vector<int> &metric = layout.qubits_metric;
+    const std::vector<int> &string = layout.qubits_string;
+    const std::vector<int> &null = layout.qubits_init_null;
+    const std::vector<int> &repeat = layout.qubits_init_repeat;
+    const std::vector<int> &buffer = layout.qubits_total_metric_buffer;
+    const std::vector<int> &beam_metric = layout.qubits_beam_metric;
+    const std::vector<int> &best_score = layout.qubits_best_score;
+    const std::vector<int> &pool = layout.qubits_ancilla_pool;
+    const std::vector<int> next_letter = slice(pool, 0, S);
+    const std::vector<int> next_metric = slice(pool, S, S + ml);
+
+    // State preparation, one round per timestep
+    BlockCounter w_prime, init_repeat, u_prime, q_prime;
+    for (int it = 0; it < L; it++) {
+      const std::vector<int> letter = slice(string, it*S, (it + 1)*S);
+      const std::vector<int> letter_metric = slice(metric, it*ml, (it + 1)*ml);
+      w_prime.add("WPrime", concat(concat(next_letter, next_metric), {null[it]}));
+      if (it > 0) {
+        init_repeat.add("InitRepeatFlag", concat(concat(slice(string, (it - 1)*S, it*S), next_letter), {repeat[it]}));
+      }
+      u_prime.add("UPrime", concat(concat(next_letter, next_metric), concat(letter, letter_metric)));
+      q_prime.add("QPrime", concat(concat(next_letter, next_metric), concat(letter, letter_metric)));
+    }
+    plan.blocks["w_prime"] = w_prime.cost();
+    plan.blocks["init_repeat"] = init_repeat.cost();
+    plan.blocks["u_prime"] = u_prime.cost();
+    plan.blocks["q_prime"] = q_prime.cost();
+
+    BlockCounter adder_chain;
+    const std::vector<int> total_metric = concat(slice(metric, 0, ml), buffer);
+    for (int it = 1; it < L; it++) {
+      const std::vector<int> metrics = concat(slice(metric, it*ml, (it + 1)*ml), slice(pool, 1, std::max(1, ms - ml)));
+      adder_chain.add("RippleCarryAdder", concat(concat(metrics, total_metric), {pool[0]}));
+    }
+    plan.blocks["adder_chain"] = adder_chain.cost();
+
+    plan.blocks["decoder_kernel"] = plan_compaction(L, S, compaction);
+
+    BlockCounter superposition_adder;
+    superposition_adder.add("SuperpositionAdder", pool);
+    plan.blocks["superposition_adder"] = superposition_adder.cost();
+
+    BlockCounter oracle;
+    const int flag = pool[0];
+    for (int qubit : best_score) {
+      oracle.add("X", {qubit});
+    }
+    oracle.add("X", {flag});
+    oracle.add("H", {flag});
+    oracle.add("CompareGT", concat(concat(beam_metric, best_score), {flag, pool[1]}));
+    oracle.add("H", {flag});
+    oracle.add("X", {flag});
+    plan.blocks["oracle"] = oracle.cost();
+
+    return plan;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  DecoderLayout layout_quantum_decoder(const ResourcePlan &plan) {
+    const int L = plan.string_length;
+    const int ml = plan.metric_precision;
+    DecoderLayout layout;
+    int next = 0;
+    layout.qubits_metric = allocate(next, L*ml);
+    layout.qubits_string = allocate(next, L*plan.nq_symbol);
+    layout.qubits_init_null = allocate(next, L);
+    layout.qubits_init_repeat = allocate(next, L);
+    layout.qubits_superfluous_flags = allocate(next, L);
+    layout.qubits_total_metric_buffer = allocate(next, plan.string_metric_precision - ml);
+    layout.qubits_beam_metric = allocate(next, plan.beam_metric_precision);
+    layout.qubits_best_score = allocate(next, plan.beam_metric_precision);
+    layout.qubits_ancilla_pool = allocate(next, plan.num_ancilla);
+    layout.num_qubits = next;
+    return layout;
+  }
+
+  int beam_metric_score(double log_probability, const ResourcePlan &plan) {
+    const double scale = std::pow(2.0, plan.string_metric_precision) - 1;
+    const double max_score = std::pow(2.0, std::min(plan.beam_metric_precision, 31)) - 1;
+    return (int)std::min(std::floor(std::exp(log_probability) * scale), max_score);
+  }
+
+  int beam_metric_lower_bound(const ProbabilityTable &probability_table, const std::vector<int> &beam,
+                              const ResourcePlan &plan) {
+    // The beam's strings are those of the CTC forward algorithm over the null-interleaved labels
+    // (0, b1, 0, b2, ..., bn, 0). For every label, count the strings of the first timesteps that end on it
+    // and the sum of their metrics: a string ending on a label at the next timestep adds that timestep's
+    // letter metric once.
+    const int L = std::min<int>(plan.string_length, probability_table.nb_timesteps());
+    const double letter_scale = std::pow(2.0, plan.metric_precision) - 1;
+    std::vector<int> labels(2*beam.size() + 1, 0);
+    for (std::size_t i = 0; i < beam.size(); i++) {
+      labels[2*i + 1] = beam[i];
+    }
+    const int n = labels.size();
+    std::vector<double> count(n, 0.0), metric(n, 0.0);
+    for (int t = 0; t < L; t++) {
+      std::vector<double> next_count(n, 0.0), next_metric(n, 0.0);
+      for (int j = 0; j < n; j++) {
+        const float probability = probability_table(t, labels[j]);
+        if (probability <= 0) {
+          continue;
+        }
+        if (t == 0) {
+          next_count[j] = j < 2 ? 1 : 0;
+        } else {
+          // Stay on the label, move on from the previous one, or skip a null between different symbols
+          next_count[j] = count[j];
+          next_metric[j] = metric[j];
+          for (int k : {j - 1, j - 2}) {
+            if (k < 0 || (k == j - 2 && (labels[j] == 0 || labels[j] == labels[k]))) {
+              continue;
+            }
+            next_count[j] += count[k];
+            next_metric[j] += metric[k];
+          }
+        }
+        next_metric[j] += next_count[j] * std::floor(probability * letter_scale);
+      }
+      count = next_count;
+      metric = next_metric;
+    }
+    double score = metric[n - 1];
+    if (n > 1) {
+      score += metric[n - 2];
+    }
+    const double max_score = std::pow(2.0, std::min(plan.beam_metric_precision, 31)) - 1;
+    return (int)std::min(score, max_score);
+  }
+
+}
@@ -1,25 +1,171 @@
 // Copyright (c) 2022 Quantum Brilliance Pty Ltd
 #include "qristal/decoder/simplified_decoder.hpp"
+#include "qristal/decoder/accelerator_pool.hpp"
+#include "qristal/decoder/batch.hpp"
+#include "qristal/decoder/beam_aggregation.hpp"
+#include "qristal/decoder/beam_collapse.hpp"
+#include "qristal/decoder/direct_sampler.hpp"
+#include "qristal/decoder/thread_pool.hpp"
+#include "qristal/decoder/timestep_pruning.hpp"
 
 #include "Algorithm.hpp"
 #include "xacc.hpp"
 #include "xacc_service.hpp"
 
+#include <algorithm>
 #include <assert.h>
 #include <bitset>
+#include <chrono>
+#include <cmath>
 #include <iomanip>
 #include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
 #include <string>
 
 namespace qristal {
 
+  namespace {
+
+    xacc::InstPtr mcx(const std::vector<int> &controls_on, const std::vector<int> &controls_off, int target) {
+      auto gate = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+          xacc::getService<xacc::Instruction>("GeneralisedMCX"));
+      gate->expand({{"controls_on", controls_on}, {"controls_off", controls_off}, {"target", target}});
+      return gate;
+    }
+
+    // Good strings of the "aa" method: per timestep the good symbols, empty where every symbol is good.
+    // good_probability is the total probability of the good strings, and iterations the number of Grover
+    // iterations that brings them closest to probability 1.
+    struct AmplificationPlan {
+      std::vector<std::vector<int>> good_symbols;
+      double good_probability;
+      int iterations;
+    };
+
+    AmplificationPlan plan_amplification(const ProbabilityTable &probability_table, double threshold) {
+      AmplificationPlan plan;
+      plan.good_probability = 1;
+      for (ProbabilityTable::Row row : probability_table) {
+        const float max_p = *std::max_element(row.begin(), row.end());
+        const double total = std::accumulate(row.begin(), row.end(), 0.0);
+        std::vector<int> good;
+        double good_p = 0;
+        bool all_good = true;
+        for (std::size_t symbol = 0; symbol < row.size(); symbol++) {
+          if (row[symbol] >= threshold*max_p) {
+            good.push_back(symbol);
+            good_p += row[symbol];
+          } else if (row[symbol] > 0) {
+            all_good = false;
+          }
+        }
+        plan.good_symbols.push_back(all_good ? std::vector<int>{} : good);
+        plan.good_probability *= total > 0 ? good_p/total : 1;
+      }
+      // Grover iterations that bring the good strings closest to probability 1
+      const double angle = std::asin(std::sqrt(std::min(plan.good_probability, 1.0)));
+      plan.iterations = angle > 0 ? std::max(0, (int)std::floor(M_PI/(4*angle))) : 0;
+      return plan;
+    }
+
+    // Probability of measuring a good string after the given number of Grover iterations
+    double amplified_probability(double good_probability, int iterations) {
+      const double angle = std::asin(std::sqrt(std::min(good_probability, 1.0)));
+      return std::pow(std::sin((2*iterations + 1)*angle), 2);
+    }
+
+    // The string state of the "ry" method, built symbol bit by symbol bit: bit b of the symbol of timestep t
+    // (on qubits_string[t*S + b], least significant first) is rotated controlled on the bits below it.
+    // A multi-controlled Ry(theta) is Ry(theta/2), MCX, Ry(-theta/2), MCX. With inverse set, the adjoint.
+    std::shared_ptr<xacc::CompositeInstruction> string_encoding(
+        const ProbabilityTable &probability_table, const std::vector<int> &qubits_string,
+        bool inverse) {
+      auto gateRegistry = xacc::getService<xacc::IRProvider>("quantum");
+      const int L = probability_table.size();
+      const int S = qubits_string.size()/L;
+      std::vector<xacc::InstPtr> gates;
+      for (int t = 0; t < L; t++) {
+        const ProbabilityTable::Row row = probability_table[t];
+        for (int b = 0; b < S; b++) {
+          const int qubit = qubits_string[t*S + b];
+          for (int prefix = 0; prefix < (1 << b); prefix++) {
+            // Probability of bit b clear and set, given the bits below it are prefix
+            double p[2] = {0, 0};
+            for (std::size_t symbol = 0; symbol < row.size(); symbol++) {
+              if ((int)(symbol & ((1u << b) - 1)) == prefix) {
+                p[(symbol >> b) & 1] += row[symbol];
+              }
+            }
+            if (p[1] <= 0) {
+              continue;
+            }
+            const double theta = 2*std::atan2(std::sqrt(p[1]), std::sqrt(p[0]));
+            std::vector<int> controls_on, controls_off;
+            for (int c = 0; c < b; c++) {
+              ((prefix >> c) & 1 ? controls_on : controls_off).push_back(qubits_string[t*S + c]);
+            }
+            if (b == 0) {
+              gates.push_back(gateRegistry->createInstruction("Ry", {(std::size_t)qubit}, {theta}));
+              continue;
+            }
+            gates.push_back(gateRegistry->createInstruction("Ry", {(std::size_t)qubit}, {theta/2}));
+            gates.push_back(mcx(controls_on, controls_off, qubit));
+            gates.push_back(gateRegistry->createInstruction("Ry", {(std::size_t)qubit}, {-theta/2}));
+            gates.push_back(mcx(controls_on, controls_off, qubit));
+          }
+        }
+      }
+
+      auto circuit = gateRegistry->createComposite(inverse ? "string_encoding_dagger" : "string_encoding");
+      if (inverse) {
+        // Every gate is an Ry, whose adjoint negates its angle, or a self-inverse MCX
+        for (auto iter = gates.rbegin(); iter != gates.rend(); ++iter) {
+          if ((*iter)->name() == "Ry") {
+            const double theta = (*iter)->getParameter(0).as<double>();
+            circuit->addInstruction(gateRegistry->createInstruction("Ry", (*iter)->bits(), {-theta}));
+          } else {
+            circuit->addInstruction(*iter);
+          }
+        }
+      } else {
+        circuit->addInstructions(gates);
+      }
+      return circuit;
+    }
+
+  }
+
   bool SimplifiedDecoder::initialize(const xacc::HeterogeneousMap &parameters) {
 
-    //std::vector<std::vector<float>> probability_table;
-    if (!parameters.keyExists<std::vector<std::vector<float>>>("probability_table")) {
-        return false;
+    // A batch of tables, each decoded as if given alone (see execute_batch). The longest fixes nq_symbol
+    // and checks the parameters, and shorter tables use the start of qubits_string.
+    probability_tables = {};
+    if (parameters.keyExists<std::vector<std::vector<std::vector<float>>>>("probability_tables")) {
+        probability_tables = parameters.get<std::vector<std::vector<std::vector<float>>>>("probability_tables");
+        if (probability_tables.empty()) {
+            return false;
+        }
+        return initialize_table(parameters, *std::max_element(probability_tables.begin(), probability_tables.end(),
+            [](const auto &a, const auto &b) { return a.size() < b.size(); }));
+    }
+    else if (parameters.keyExists<ProbabilityTable>("probability_table")) {
+        return initialize_table(parameters, parameters.get<ProbabilityTable>("probability_table"));
     }
-    probability_table = parameters.get<std::vector<std::vector<float>>>("probability_table");
+    else if (parameters.keyExists<std::vector<std::vector<float>>>("probability_table")) {
+        return initialize_table(parameters, parameters.get<std::vector<std::vector<float>>>("probability_table"));
+    }
+    return false;
+
+  } //SimplifiedDecoder::initialize
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  bool SimplifiedDecoder::initialize_table(const xacc::HeterogeneousMap &parameters, const ProbabilityTable &table) {
+
+    probability_table = table;
+    parameters_ = parameters;
 
     //std::vector<int> qubits_string;
     if (!parameters.keyExists<std::vector<int>>("qubits_string")) {
@@ -32,6 +178,34 @@ namespace qristal {
     nq_symbol = nq_string/nb_timesteps;
     assert(nb_timesteps*nq_symbol == nq_string);
 
+    // Classical pruning of decided null and repeat timesteps before encoding (see timestep_pruning.hpp), off
+    // by default. The pruned table uses the start of qubits_string.
+    prune_blank_threshold = parameters.get_or_default("prune_blank_threshold", 1.0);
+    prune_repeat_threshold = parameters.get_or_default("prune_repeat_threshold", 1.0);
+    pruned_.reset();
+    if (probability_tables.empty() && (prune_blank_threshold < 1.0 || prune_repeat_threshold < 1.0)) {
+        pruned_ = prune_timesteps(probability_table, prune_blank_threshold, prune_repeat_threshold);
+        probability_table = pruned_->probability_table;
+        nb_timesteps = probability_table.size();
+        nq_string = nb_timesteps*nq_symbol;
+        qubits_string.resize(nq_string);
+    }
+
+    // Encode each timestep's plausible symbols only, on fewer qubits (see symbol_codebook.hpp), off by default
+    codebook_top_k = parameters.get_or_default("codebook_top_k", 0);
+    codebook_mass = parameters.get_or_default("codebook_mass", 1.0);
+    codebook_.reset();
+    nq_code = nq_symbol;
+    if (probability_tables.empty() && (codebook_top_k > 0 || codebook_mass < 1.0)) {
+        codebook_.emplace(probability_table, codebook_top_k, codebook_mass);
+        probability_table = codebook_->code_table();
+        nq_code = codebook_->nq_code();
+        if (nq_code > nq_symbol) {
+            return false;
+        }
+        qubits_string.resize(nb_timesteps*nq_code);
+    }
+
     //////////////////////////////////////////////////////////////////////////////////////
 
     //Parameters for comparator oracle in exponential search
@@ -48,43 +222,79 @@ namespace qristal {
     method = "ry";
     if (parameters.keyExists<std::string>("method")) {
         method = parameters.get<std::string>("method");
-        // Assert that given builder_name is acceptable and
+    }
+    if (method != "ry" && method != "aa" && method != "direct-sample") {
+        return false;
+    }
+
+    // Good symbols and Grover iterations for "aa"; -1 iterations for the optimal number
+    aa_threshold = parameters.get_or_default("aa_threshold", 0.5);
+    aa_iterations = parameters.get_or_default("aa_iterations", -1);
+    qubits_ancilla = {};
+    if (parameters.keyExists<std::vector<int>>("qubits_ancilla")) {
+      qubits_ancilla = parameters.get<std::vector<int>>("qubits_ancilla");
+    } else {
+      // Straight after the string
+      const int first = *std::max_element(qubits_string.begin(), qubits_string.end()) + 1;
+      for (int i = 0; i <= nb_timesteps; i++) {
+        qubits_ancilla.push_back(first + i);
+      }
+    }
+    if ((int)qubits_ancilla.size() < nb_timesteps + 1) {
+        return false;
     }
 
     //////////////////////////////////////////////////////////////////////////////////////
 
-    //Initialize qpu accelerator
+    //Initialize qpu accelerator: an accelerator instance is used as given, otherwise every thread
+    //executing the decoder gets its own, from the accelerator_pool given or from a pool of the named
+    //qpu owned by the decoder
     qpu_ = nullptr;
-    if (parameters.stringExists("qpu")) {
-      static auto acc =
-          xacc::getAccelerator(parameters.getString("qpu"), {{"shots", 1}});
-      qpu_ = acc.get();
-    } else if (parameters.pointerLikeExists<xacc::Accelerator>("qpu")) {
+    accelerator_pool_ = nullptr;
+    owned_accelerator_pool_.reset();
+    if (parameters.pointerLikeExists<xacc::Accelerator>("qpu")) {
       qpu_ = parameters.getPointerLike<xacc::Accelerator>("qpu");
+    } else if (parameters.pointerLikeExists<AcceleratorPool>("accelerator_pool")) {
+      accelerator_pool_ = parameters.getPointerLike<AcceleratorPool>("accelerator_pool");
+    } else {
+      // Default to qpp if none provided
+      const std::string name = parameters.stringExists("qpu") ? parameters.getString("qpu") : "qpp";
+      owned_accelerator_pool_ = std::make_shared<AcceleratorPool>(name, xacc::HeterogeneousMap{{"shots", 1}});
+      accelerator_pool_ = owned_accelerator_pool_.get();
     }
 
-    if (!qpu_) {
-      static auto qpp = xacc::getAccelerator("qpp", {{"shots", 1}});
-      // Default to qpp if none provided
-      qpu_ = qpp.get();
+    // Threads used to aggregate beams; 0 uses all hardware threads
+    num_threads = parameters.get_or_default("num_threads", 0);
+
+    // Sequential decode: shots are drawn shot_batch at a time (0 draws them all at once), until the leading
+    // beam beats the runner-up at the given confidence
+    shot_batch = parameters.get_or_default("shot_batch", 0);
+    confidence = parameters.get_or_default("confidence", 0.99);
+
+    // Shots and seed for the "direct-sample" method
+    shots = parameters.get_or_default("shots", 0);
+    seed.reset();
+    if (parameters.keyExists<int>("seed")) {
+        seed = parameters.get<int>("seed");
     }
 
     if (parameters.keyExists<bool>("is_msb")) {
         is_msb = parameters.get<bool>("is_msb");
     }
-    else if (qpu_->name() == "aer") {    // aer qpu has lsb convention
+    else if (qpu_name() == "aer") {    // aer qpu has lsb convention
         is_msb = true;
     }
 
 
     return true;
 
-  } //SimplifiedDecoder::initialize
+  } //SimplifiedDecoder::initialize_table
 
 
   /////////////////////////////////////////////////////////////////////////////////////////////
 
   const std::vector<std::string> SimplifiedDecoder::requiredParameters() const {
+    // probability_table may instead be a batch, probability_tables
     return {"probability_table", "qubits_string"};
             //"method", "BestScore", "iteration", "qubits_metric", "qubits_beam_metric", "qubits_superfluous_flags",
             //"num_scoring_qubits", "qubits_init_null", "qubits_init_repeat",
@@ -96,19 +306,109 @@ namespace qristal {
   void SimplifiedDecoder::execute(
       const std::shared_ptr<xacc::AcceleratorBuffer> buffer) const {
 
-      qristal::CircuitBuilder circ;
+    if (!probability_tables.empty()) {
+      execute_batch(buffer);
+      return;
+    }
+
+    // This thread's accelerator, held exclusively until the decode ends unless threads have their own.
+    // "direct-sample" runs no circuit, so needs no accelerator.
+    xacc::Accelerator *qpu = nullptr;
+    std::unique_lock<std::mutex> exclusive;
+    if ("direct-sample" != method) {
+      qpu = accelerator();
+      if (accelerator_pool_) {
+        exclusive = accelerator_pool_->exclusive();
+      }
+    }
 
-      const int nq_symbol_const = nq_symbol;
+    // Kernel: collapse each measured string into its beam, working on bit-packed symbols
+    const BeamCollapser collapser(nb_timesteps, nq_symbol, is_msb);
 
-      if ("ry" == method) {
-          const xacc::HeterogeneousMap &map = {
-              {"probability_table", probability_table},
-              {"qubits_string", qubits_string}};
+    // Shots of "direct-sample" and the shot budget of a sequential decode: the shots option, else the
+    // qpu's, else 1024
+    int qpu_shots = 1024;
+    if (qpu) {
+      const xacc::HeterogeneousMap properties = qpu->getProperties();
+      if (properties.keyExists<int>("shots")) {
+        qpu_shots = properties.get<int>("shots");
+      }
+    }
+    const int nb_shots = shots > 0 ? shots : qpu_shots;
+
+    std::optional<DirectSampler> sampler;
+    std::uint64_t sample_seed = 0;
+    std::shared_ptr<xacc::CompositeInstruction> circuit;
+
+    if ("direct-sample" == method) {
+      // The "ry" circuit prepares a product state over timesteps, so draw its measured strings directly
+      // from the probability table, in the bit order of the chosen qpu
+      sample_seed = seed ? *seed : std::random_device()();
+      sampler.emplace(probability_table, nq_symbol, qpu_name() == "aer",
+                      codebook_ ? codebook_->symbols() : std::vector<std::vector<int>>{});
+    }
+    else if ("aa" == method) {
+      // Amplitude amplification of the strings whose every symbol is good, i.e. at least aa_threshold times
+      // the most probable symbol of its timestep. Among the good strings (and among the rest) the relative
+      // probabilities of the "ry" state are kept, so the likely beams come out in fewer shots.
+      auto gateRegistry = xacc::getService<xacc::IRProvider>("quantum");
+      const AmplificationPlan plan = plan_amplification(probability_table, aa_threshold);
+      const int nb_iterations = aa_iterations >= 0 ? aa_iterations : plan.iterations;
+      const int phase = qubits_ancilla[nb_timesteps];
+
+      circuit = gateRegistry->createComposite("amplified_strings");
+      circuit->addInstruction(string_encoding(probability_table, qubits_string, false));
+      // The phase qubit is held in |->, so an MCX onto it flips the phase of the states it fires on
+      circuit->addInstruction(gateRegistry->createInstruction("X", phase));
+      circuit->addInstruction(gateRegistry->createInstruction("H", phase));
+      for (int it = 0; it < nb_iterations; it++) {
+        // Oracle: flag the timesteps holding a good symbol, flip the phase if all are flagged, unflag
+        std::vector<xacc::InstPtr> flag_gates;
+        std::vector<int> flags;
+        for (int t = 0; t < nb_timesteps; t++) {
+          if (plan.good_symbols[t].empty()) {
+            continue; // every symbol is good
+          }
+          flags.push_back(qubits_ancilla[t]);
+          for (int symbol : plan.good_symbols[t]) {
+            std::vector<int> controls_on, controls_off;
+            for (int b = 0; b < nq_code; b++) {
+              ((symbol >> b) & 1 ? controls_on : controls_off).push_back(qubits_string[t*nq_code + b]);
+            }
+            flag_gates.push_back(mcx(controls_on, controls_off, qubits_ancilla[t]));
+          }
+        }
+        if (!flags.empty()) { // otherwise every string is good and the oracle is a global phase
+          circuit->addInstructions(flag_gates);
+          circuit->addInstruction(mcx(flags, {}, phase));
+          circuit->addInstructions(flag_gates);
+        }
 
-          qristal::RyEncoding build;
-          const bool expand_ok = build.expand(map);
-          circ.append(build);
+        // Diffusion about the "ry" state: flip the phase of |0...0> between its adjoint and itself
+        circuit->addInstruction(string_encoding(probability_table, qubits_string, true));
+        circuit->addInstruction(mcx({}, qubits_string, phase));
+        circuit->addInstruction(string_encoding(probability_table, qubits_string, false));
       }
+      circuit->addInstruction(gateRegistry->createInstruction("H", phase));
+      circuit->addInstruction(gateRegistry->createInstruction("X", phase));
+      for (int qubit : qubits_string) {
+          circuit->addInstruction(gateRegistry->createInstruction("Measure", qubit));
+      }
+
+      buffer->addExtraInfo("aa_iterations", nb_iterations);
+      buffer->addExtraInfo("aa_good_probability", plan.good_probability);
+      buffer->addExtraInfo("aa_success_probability", amplified_probability(plan.good_probability, nb_iterations));
+    }
+    else {
+      qristal::CircuitBuilder circ;
+
+      const xacc::HeterogeneousMap &map = {
+          {"probability_table", probability_table.to_rows()},
+          {"qubits_string", qubits_string}};
+
+      qristal::RyEncoding build;
+      const bool expand_ok = build.expand(map);
+      circ.append(build);
 
       // Measure
       for (int qubit : qubits_string) {
@@ -116,129 +416,159 @@ namespace qristal {
       }
 
       // Construct the full circuit including preparation of input trial score
-      //std::cout << "\ncirc.get()" << std::endl;
-      auto circuit = circ.get();
-
-      // Run circuit
-      //std::cout << circuit->toString() << '\n';
-      qpu_->execute(buffer, circuit);  // acc
-      std::map<std::string, int> measurements = buffer->getMeasurementCounts();
-      std::string output_string = buffer->toString() ;
-
-    /////////////////////////////////////////////////////////////////////////////////////////////
+      circuit = circ.get();
+    }
 
-    //Initiate kernel function
-    const std::function<std::string(std::string)> f_kernel_ = [&](std::string string_) {
-        std::string no_repeats_;
-        std::string beam_;
-        std::string null_char_ ;
-        // nq_symbol cannot be known at compile time
-        switch (nq_symbol) {
-            case 1:
-                null_char_ = std::bitset<1>(0).to_string();
-                break;
-            case 2:
-                null_char_ = std::bitset<2>(0).to_string();
-                break;
-            case 3:
-                null_char_ = std::bitset<3>(0).to_string();
-                break;
-            case 4:
-                null_char_ = std::bitset<4>(0).to_string();
-                break;
-            case 5:
-                null_char_ = std::bitset<5>(0).to_string();
-                break;
-      default:
-          throw std::runtime_error("Invalid number of nq_symbol!\n");
+    // Draw a batch of shots and sum their counts per beam. The circuit methods run with the qpu's shots.
+    auto run_batch = [&](int batch_shots, std::uint64_t batch,
+                         const std::shared_ptr<xacc::AcceleratorBuffer> &batch_buffer) {
+      if (sampler) {
+        return sampler->sample_beams(batch_shots, collapser, sample_seed + batch, num_threads);
+      }
+      qpu->execute(batch_buffer, circuit);
+      // Sum shot counts per beam in a hash table, sharded across threads. Beams come back in the order of
+      // their bitstrings, so they are reported in the same order as before.
+      if (codebook_) {
+        return aggregate_beams(codebook_->translate(batch_buffer->getMeasurementCounts(), nq_symbol,
+                                                    qpu->name() == "aer"),
+                               collapser, num_threads);
+      }
+      return aggregate_beams(batch_buffer->getMeasurementCounts(), collapser, num_threads);
+    };
+
+    std::vector<std::pair<PackedBeam, int>> beams;
+    if (shot_batch > 0) {
+      // Sequential decode: draw shot_batch shots at a time, until the leading beam beats the runner-up at
+      // the requested confidence or the shots run out
+      BeamCountTable counts;
+      int shots_used = 0;
+      double achieved_confidence = 0;
+      for (std::uint64_t batch = 0; shots_used < nb_shots; batch++) {
+        const int batch_shots = std::min(shot_batch, nb_shots - shots_used);
+        if (circuit) {
+          qpu->updateConfiguration({{"shots", batch_shots}});
         }
-
-        // Contract repeats in string_
-        std::string current_char_;
-        current_char_ = string_.substr(0,nq_symbol);
-        int current_place_ = 0;  // Last new symbol
-        int next_place_ = current_place_;
-        std::string next_char_ = current_char_;    // Next non-repeat symbol
-        int no_repeat_length = 0;
-        while (current_place_ < nb_timesteps) {
-      if (is_msb) {
-                no_repeats_ = current_char_ + no_repeats_;
-      }
-      else {
-                no_repeats_ += current_char_;
-      }
-            no_repeat_length++;
-            next_place_++;
-            next_char_ = string_.substr(next_place_*nq_symbol,nq_symbol);
-            while ((next_char_ == current_char_) and (current_place_ < nb_timesteps)) {
-                current_place_ = next_place_;
-                next_place_++;
-                next_char_ = string_.substr(next_place_*nq_symbol,nq_symbol);
-            }
-            current_char_ = next_char_;
-            current_place_ = next_place_;
+        for (const auto &[beam, count] : run_batch(batch_shots, batch, xacc::qalloc(buffer->size()))) {
+          counts.add(beam, count);
         }
-
-        // Remove nulls from no_repeats_.
-        current_place_ = -1;
-        next_char_ = "";
-        while (current_place_ < no_repeat_length) {
-            beam_ += next_char_;  // no_repeats_.substr(current_place_, next_place_-(nq_symbol*current_place_));
-            current_place_++;
-            next_char_ = no_repeats_.substr(current_place_*nq_symbol,nq_symbol);
-            if ((next_char_ == null_char_) & (current_place_ < no_repeat_length)){
-                current_place_++;
-                next_char_ = no_repeats_.substr(current_place_*nq_symbol,nq_symbol);
-            }
-            //std::cout << "beam: " << beam_ << std::endl;
+        shots_used += batch_shots;
+
+        int leader = 0, runner_up = 0;
+        counts.for_each([&](const PackedBeam &, int count) {
+          if (count > leader) {
+            runner_up = leader;
+            leader = count;
+          } else if (count > runner_up) {
+            runner_up = count;
+          }
+        });
+        achieved_confidence = leader_confidence(leader, runner_up);
+        if (achieved_confidence >= confidence) {
+          break;
         }
-        //std::cout << "final beam:" << beam_ << std::endl;
-
-        //buffer->addExtraInfo("output string",beam_);
-
-        return beam_; };
-
+      }
+      if (circuit) {
+        qpu->updateConfiguration({{"shots", qpu_shots}});
+      }
+      beams = counts.sorted();
+      buffer->addExtraInfo("confidence", achieved_confidence);
+      buffer->addExtraInfo("shots_used", shots_used);
+    }
+    else {
+      beams = run_batch(nb_shots, 0, buffer);
+    }
 
     /////////////////////////////////////////////////////////////////////////////////////////////
 
-
-      std::map<std::string, int>::iterator iter;
-      std::map<std::string, int> beams;
-      std::string input_string;
-      std::string beam;
-      for (iter = measurements.begin(); iter != measurements.end(); iter++){
-          input_string = iter->first;
-          beam = f_kernel_(input_string);
-          if (beams.count(beam) == 0) {
-              beams[beam] = 0;
-          }
-
-          beams[beam] += iter->second;
-      }
-
       //buffer->addExtraInfo("output_strings", (std::map<std::string, int>) beams);
+      if (beams.empty()) {
+          throw std::runtime_error("No shots to decode!\n");
+      }
       std::cout << "max beam:" ;
       auto max_beam_entry = std::max_element(beams.begin(),beams.end(), [](const auto &x, const auto &y){
           return x.second < y.second;
       });
-      std::string max_beam = max_beam_entry->first;
+      std::string max_beam = collapser.to_string(max_beam_entry->first);
       std::cout << max_beam << std::endl;
       buffer->addExtraInfo("best_beam", max_beam);  //->first);
       // Output beams and their shot counts
       int nb_beams = 0;
-      for (iter = beams.begin(); iter != beams.end(); iter++ ) {
-          std::cout << iter->first << ": " << iter->second << std::endl;
+      for (auto iter = beams.begin(); iter != beams.end(); iter++ ) {
+          std::string beam_string = collapser.to_string(iter->first);
+          std::cout << beam_string << ": " << iter->second << std::endl;
           std::string beam_label = "beam_" + std::to_string(nb_beams);
-          buffer->addExtraInfo(beam_label,(std::string) iter->first);
+          buffer->addExtraInfo(beam_label, beam_string);
           std::string beam_count_label = "beam_count_" + std::to_string(nb_beams);
           buffer->addExtraInfo(beam_count_label,(int) iter->second);
           nb_beams++;
       }
       buffer->addExtraInfo("nb_beams",nb_beams);
+      if (codebook_) {
+          buffer->addExtraInfo("nq_code", nq_code);
+          buffer->addExtraInfo("codebook_discarded_probability", codebook_->discarded_probability());
+      }
+      if (pruned_) {
+          buffer->addExtraInfo("blanks_pruned", pruned_->nb_blanks_pruned);
+          buffer->addExtraInfo("repeats_merged", pruned_->nb_repeats_merged);
+          buffer->addExtraInfo("discarded_probability", pruned_->discarded_probability);
+      }
 
 
   } // SimplifiedDecoder::execute
 
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  void SimplifiedDecoder::execute_batch(const std::shared_ptr<xacc::AcceleratorBuffer> buffer) const {
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t nb_utterances = probability_tables.size();
+
+    // Decode every table with its own decoder, as if it had been given alone
+    std::vector<std::shared_ptr<xacc::AcceleratorBuffer>> results(nb_utterances);
+    const std::vector<std::size_t> order = batch_order(probability_tables);
+    auto decode = [&](std::size_t k) {
+      const std::size_t i = order[k];
+      const auto &table = probability_tables[i];
+      xacc::HeterogeneousMap utterance = parameters_;
+      utterance.insert("qubits_string", std::vector<int>(qubits_string.begin(),
+                                                         qubits_string.begin() + table.size()*nq_symbol));
+      if (seed) {
+        utterance.insert("seed", (int)(*seed + i));
+      }
+      if (accelerator_pool_) {
+        utterance.insert("accelerator_pool", accelerator_pool_);
+      }
+      SimplifiedDecoder decoder;
+      if (!decoder.initialize_table(utterance, table)) {
+        throw std::runtime_error("Cannot decode probability table " + std::to_string(i) + " of the batch!\n");
+      }
+      results[i] = xacc::qalloc(buffer->size());
+      decoder.execute(results[i]);
+    };
+    if ("direct-sample" == method || (accelerator_pool_ && !accelerator_pool_->shared())) {
+      // Utterances are independent, so they run across the thread pool, each thread on its own accelerator
+      default_thread_pool().parallel_for(nb_utterances, [&](std::size_t k) {
+        decode(k);
+      });
+    }
+    else {
+      // A qpu given as an instance, or shared by the pool, runs one circuit at a time
+      for (std::size_t k = 0; k < nb_utterances; k++) {
+        decode(k);
+      }
+    }
+
+    std::vector<std::string> best_beams;
+    for (std::size_t i = 0; i < nb_utterances; i++) {
+      buffer->appendChild("utterance_" + std::to_string(i), results[i]);
+      best_beams.push_back(results[i]->getInformation().at("best_beam").as<std::string>());
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    buffer->addExtraInfo("best_beams", best_beams);
+    buffer->addExtraInfo("nb_utterances", (int)nb_utterances);
+    buffer->addExtraInfo("batch_seconds", elapsed.count());
+    buffer->addExtraInfo("utterances_per_second", nb_utterances/elapsed.count());
+  } // SimplifiedDecoder::execute_batch
+
 }
 
 REGISTER_PLUGIN(qristal::SimplifiedDecoder, xacc::Algorithm)
@@ -0,0 +1,121 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/streaming.hpp"
+#include "qristal/decoder/ctc_reference.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace qristal {
+
+  namespace {
+
+    // Collapse labels onto symbols, continuing from the label of the previous timestep
+    void collapse(const std::vector<int> &labels, int &previous, std::vector<int> &symbols) {
+      for (int label : labels) {
+        if (label != 0 && label != previous) {
+          symbols.push_back(label);
+        }
+        previous = label;
+      }
+    }
+
+  }
+
+  WindowStitcher::WindowStitcher(int window_size, int hop) : window_size_(window_size), hop_(hop) {
+    if (hop < 1 || hop > window_size) {
+      throw std::runtime_error("The hop must be from 1 to the window size!\n");
+    }
+    frames_.reserve(window_size);
+  }
+
+  bool WindowStitcher::push(std::vector<float> frame) {
+    if (finished_) {
+      throw std::runtime_error("Frame pushed after the end of the utterance!\n");
+    }
+    if ((int)frames_.size() >= window_size_) {
+      throw std::runtime_error("The full window must be decoded before the next frame is pushed!\n");
+    }
+    frames_.push_back(std::move(frame));
+    frames_seen_++;
+    return (int)frames_.size() == window_size_;
+  }
+
+  bool WindowStitcher::finish() {
+    finished_ = true;
+    if (frames_committed_ == frames_seen_) {
+      frames_.clear();
+      tentative_.clear();
+      return false;
+    }
+    return true;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  void WindowStitcher::commit(const std::vector<int> &beam) {
+    const int window_end = window_start_ + (int)frames_.size();
+    const std::vector<int> alignment = CtcReference(frames_).align(beam);
+
+    // Commit up to the middle of the overlap with the next window, whose left context is better there
+    const int overlap = window_size_ - hop_;
+    const int commit_end = finished_ ? window_end : window_start_ + window_size_ - (overlap + 1) / 2;
+    collapse(std::vector<int>(alignment.begin() + (frames_committed_ - window_start_),
+                              alignment.begin() + (commit_end - window_start_)),
+             previous_label_, committed_);
+    tentative_.assign(alignment.begin() + (commit_end - window_start_), alignment.end());
+    frames_committed_ = commit_end;
+
+    // Slide on
+    if (finished_) {
+      frames_.clear();
+      window_start_ = window_end;
+    } else {
+      frames_.erase(frames_.begin(), frames_.begin() + hop_);
+      window_start_ += hop_;
+    }
+  }
+
+  std::vector<int> WindowStitcher::hypothesis() const {
+    std::vector<int> symbols = committed_;
+    int previous = previous_label_;
+    collapse(tentative_, previous, symbols);
+    return symbols;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<int> ctc_collapse(const std::vector<int> &labels) {
+    std::vector<int> symbols;
+    int previous = 0;
+    collapse(labels, previous, symbols);
+    return symbols;
+  }
+
+  std::vector<int> beam_symbols(const std::string &bitstring, int nq_symbol, bool is_msb,
+                                bool reversed_bit_order) {
+    if (nq_symbol < 1 || bitstring.size() % nq_symbol != 0) {
+      throw std::runtime_error("Beam bitstring is not a whole number of symbols!\n");
+    }
+    std::vector<int> symbols(bitstring.size() / nq_symbol, 0);
+    for (std::size_t k = 0; k < symbols.size(); k++) {
+      for (int bit = 0; bit < nq_symbol; bit++) {
+        if (bitstring[k * nq_symbol + bit] == '1') {
+          symbols[k] |= 1 << (reversed_bit_order ? nq_symbol - 1 - bit : bit);
+        }
+      }
+    }
+    if (is_msb != reversed_bit_order) {
+      std::reverse(symbols.begin(), symbols.end());
+    }
+    return symbols;
+  }
+  std::vector<int> compacted_beam(const std::string &best_string, int beam_length, int nq_symbol) {
+    if (beam_length < 0 || (std::size_t)beam_length * nq_symbol > best_string.size()) {
+      throw std::runtime_error("Beam length exceeds the string register!\n");
+    }
+    return beam_symbols(best_string.substr(0, beam_length * nq_symbol), nq_symbol, false);
+  }
+
+
+}
@@ -0,0 +1,95 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/symbol_codebook.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace qristal {
+
+  SymbolCodebook::SymbolCodebook(const ProbabilityTable &probability_table, int top_k, double mass) {
+    double log_kept = 0.0;
+    std::size_t nb_codes = 1;
+    for (ProbabilityTable::Row row : probability_table) {
+      const double total = std::accumulate(row.begin(), row.end(), 0.0);
+      if (!(total > 0.0)) {
+        throw std::runtime_error("Every row of the probability table needs a non-zero probability!\n");
+      }
+      std::vector<int> order(row.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return row[a] > row[b]; });
+
+      // Most probable first, until the mass or the count is reached
+      std::vector<int> kept;
+      double kept_mass = 0.0;
+      for (int symbol : order) {
+        if (!kept.empty() && (kept_mass >= mass * total || (top_k > 0 && (int)kept.size() >= top_k))) {
+          break;
+        }
+        kept.push_back(symbol);
+        kept_mass += row[symbol];
+      }
+      log_kept += std::log(kept_mass / total);
+      nb_codes = std::max(nb_codes, kept.size());
+      symbols_.push_back(std::move(kept));
+    }
+
+    nq_code_ = std::max(1, (int)std::ceil(std::log2((double)nb_codes)));
+    for (std::size_t t = 0; t < probability_table.size(); t++) {
+      auto &kept = symbols_[t];
+      double kept_mass = 0.0;
+      for (int symbol : kept) {
+        kept_mass += probability_table[t][symbol];
+      }
+      std::vector<float> codes(nb_codes, 0.0f);
+      for (std::size_t code = 0; code < kept.size(); code++) {
+        codes[code] = probability_table[t][kept[code]] / kept_mass;
+      }
+      kept.resize(nb_codes, 0);
+      code_table_.push_back(std::move(codes));
+    }
+    discarded_probability_ = 1.0 - std::exp(log_kept);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::string SymbolCodebook::translate(const std::string &bitstring, int nq_symbol, bool reversed_bit_order) const {
+    const int nb_timesteps = symbols_.size();
+    if ((int)bitstring.size() < nb_timesteps * nq_code_) {
+      throw std::runtime_error("Measured bitstring is shorter than nb_timesteps*nq_code!\n");
+    }
+    // Symbol bits are measured least significant first; reversing the whole string also reverses the
+    // timesteps and restores the natural bit order within each symbol
+    std::string translated(nb_timesteps * nq_symbol, '0');
+    for (int position = 0; position < nb_timesteps; position++) {
+      const int t = reversed_bit_order ? nb_timesteps - 1 - position : position;
+      std::size_t code = 0;
+      for (int b = 0; b < nq_code_; b++) {
+        const int bit = reversed_bit_order ? nq_code_ - 1 - b : b;
+        if (bitstring[position * nq_code_ + b] == '1') {
+          code |= std::size_t(1) << bit;
+        }
+      }
+      const int symbol = code < symbols_[t].size() ? symbols_[t][code] : 0;
+      for (int b = 0; b < nq_symbol; b++) {
+        const int bit = reversed_bit_order ? nq_symbol - 1 - b : b;
+        if ((symbol >> bit) & 1) {
+          translated[position * nq_symbol + b] = '1';
+        }
+      }
+    }
+    return translated;
+  }
+
+  std::map<std::string, int> SymbolCodebook::translate(const std::map<std::string, int> &measurements,
+                                                       int nq_symbol, bool reversed_bit_order) const {
+    std::map<std::string, int> translated;
+    for (const auto &[bitstring, count] : measurements) {
+      translated[translate(bitstring, nq_symbol, reversed_bit_order)] += count;
+    }
+    return translated;
+  }
+
+}
@@ -0,0 +1,122 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace qristal {
+
+  ThreadPool::ThreadPool(std::size_t nb_threads) {
+    for (std::size_t i = 0; i < nb_threads; i++) {
+      workers_.emplace_back([this] { run(); });
+    }
+  }
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) {
+      worker.join();
+    }
+  }
+
+  void ThreadPool::run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return; // stopping and drained
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  void ThreadPool::submit(std::function<void()> task) {
+    if (workers_.empty()) {
+      task();
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  void ThreadPool::parallel_for(std::size_t n, const std::function<void(std::size_t)> &fn) {
+    if (n == 0) {
+      return;
+    }
+    if (n == 1 || workers_.empty()) {
+      for (std::size_t i = 0; i < n; i++) {
+        fn(i);
+      }
+      return;
+    }
+
+    // Shared with the helper tasks, which may only get to run after this call has returned
+    struct Job {
+      std::function<void(std::size_t)> fn;
+      std::size_t n;
+      std::atomic<std::size_t> next{0};
+      std::size_t done = 0;
+      std::exception_ptr error;
+      std::mutex mutex;
+      std::condition_variable finished;
+    };
+    auto job = std::make_shared<Job>();
+    job->fn = fn;
+    job->n = n;
+
+    auto work = [](const std::shared_ptr<Job> &job) {
+      for (std::size_t i = job->next++; i < job->n; i = job->next++) {
+        std::exception_ptr error;
+        try {
+          job->fn(i);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(job->mutex);
+        if (error && !job->error) {
+          job->error = error;
+        }
+        if (++job->done == job->n) {
+          job->finished.notify_all();
+        }
+      }
+    };
+
+    const std::size_t nb_helpers = std::min(n - 1, workers_.size());
+    for (std::size_t h = 0; h < nb_helpers; h++) {
+      submit([job, work] { work(job); });
+    }
+    work(job);
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&] { return job->done == job->n; });
+    if (job->error) {
+      std::rethrow_exception(job->error);
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  ThreadPool &default_thread_pool() {
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+  }
+
+}
@@ -0,0 +1,103 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/timestep_pruning.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace qristal {
+
+  PrunedTable prune_timesteps(const ProbabilityTable &probability_table, double blank_threshold,
+                              double repeat_threshold) {
+    PrunedTable pruned;
+    pruned.nb_timesteps = probability_table.size();
+    double log_kept = 0.0; // log probability of the decided timesteps going the way decided
+
+    auto emit = [&](ProbabilityTable::Row row, int first, int last) {
+      pruned.probability_table.emplace_back(row.begin(), row.end());
+      pruned.first_timestep.push_back(first);
+      pruned.last_timestep.push_back(last);
+    };
+
+    // Pending run of decided nulls
+    int run_start = -1;
+    double run_log_probability = 0.0;
+    bool last_row_is_run = false; // the last row emitted is a merged null run
+
+    const int nb_timesteps = probability_table.size();
+    for (int t = 0; t <= nb_timesteps; t++) {
+      const bool blank = t < nb_timesteps && probability_table[t][0] > blank_threshold;
+      if (blank) {
+        if (run_start < 0) {
+          run_start = t;
+          run_log_probability = 0.0;
+        }
+        run_log_probability += std::log(probability_table[t][0]);
+        continue;
+      }
+
+      // End of a run of nulls: dropped at either end of the table, merged if longer than one timestep
+      if (run_start >= 0) {
+        const int run_length = t - run_start;
+        if (pruned.probability_table.empty() || t == nb_timesteps) {
+          pruned.nb_blanks_pruned += run_length;
+          log_kept += run_log_probability;
+        } else if (run_length == 1) {
+          emit(probability_table[run_start], run_start, run_start);
+          last_row_is_run = false;
+        } else {
+          std::vector<float> certain_null(probability_table[run_start].size(), 0.0f);
+          certain_null[0] = 1.0f;
+          emit(certain_null, run_start, t - 1);
+          last_row_is_run = true;
+          pruned.nb_blanks_pruned += run_length;
+          log_kept += run_log_probability;
+        }
+        run_start = -1;
+      }
+      if (t == nb_timesteps) {
+        break;
+      }
+
+      // A decided repeat of the row before
+      const ProbabilityTable::Row row = probability_table[t];
+      const int symbol = std::max_element(row.begin(), row.end()) - row.begin();
+      if (symbol != 0 && row[symbol] > repeat_threshold && !pruned.probability_table.empty() && !last_row_is_run &&
+          pruned.probability_table.back()[symbol] > repeat_threshold) {
+        pruned.last_timestep.back() = t;
+        pruned.nb_repeats_merged++;
+        log_kept += std::log(row[symbol]);
+        continue;
+      }
+
+      emit(row, t, t);
+      last_row_is_run = false;
+    }
+
+    // A table of nothing but decided nulls keeps one row, for the decoders to have a timestep to decode
+    if (pruned.probability_table.empty() && nb_timesteps > 0) {
+      std::vector<float> certain_null(probability_table[0].size(), 0.0f);
+      certain_null[0] = 1.0f;
+      emit(certain_null, 0, nb_timesteps - 1);
+    }
+
+    pruned.discarded_probability = 1.0 - std::exp(log_kept);
+    return pruned;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////////////////////
+
+  std::vector<int> unprune_string(const PrunedTable &pruned, const std::vector<int> &string) {
+    if (string.size() != pruned.probability_table.size()) {
+      throw std::runtime_error("String length does not match the pruned table!\n");
+    }
+    // Timesteps no row stands for are dropped nulls
+    std::vector<int> original(pruned.nb_timesteps, 0);
+    for (std::size_t k = 0; k < string.size(); k++) {
+      std::fill(original.begin() + pruned.first_timestep[k], original.begin() + pruned.last_timestep[k] + 1, string[k]);
+    }
+    return original;
+  }
+
+}
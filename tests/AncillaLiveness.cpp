@@ -0,0 +1,85 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/ancilla_liveness.hpp"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace {
+
+  int next_id = 0;
+
+  qristal::CircuitNode gate(const std::string &name, std::vector<int> qubits) {
+    qristal::CircuitNode node;
+    node.name = name;
+    node.qubits = qubits;
+    node.id = next_id++;
+    return node;
+  }
+
+  // Toffoli in Clifford+T gates, so no single gate of it is a permutation
+  qristal::CircuitNode toffoli(int a, int b, int t) {
+    qristal::CircuitNode node;
+    node.composite = true;
+    node.name = "toffoli";
+    node.children = {gate("H", {t}), gate("CNOT", {b, t}), gate("Tdg", {t}), gate("CNOT", {a, t}),
+                     gate("T", {t}), gate("CNOT", {b, t}), gate("Tdg", {t}), gate("CNOT", {a, t}),
+                     gate("T", {b}), gate("T", {t}), gate("H", {t}), gate("CNOT", {a, b}),
+                     gate("T", {a}), gate("Tdg", {b}), gate("CNOT", {a, b})};
+    return node;
+  }
+
+  qristal::CircuitNode circuit(std::vector<qristal::CircuitNode> children) {
+    qristal::CircuitNode node;
+    node.composite = true;
+    node.name = "circuit";
+    node.children = std::move(children);
+    return node;
+  }
+
+  std::vector<int> qubits_of(const qristal::AncillaReuse &reuse, int id) {
+    for (const auto &gate : reuse.gates) {
+      if (gate.id == id) return gate.qubits;
+    }
+    return {};
+  }
+
+}
+
+TEST(AncillaLiveness, computeUncompute) {
+  // Two ancillas, each computed with a Toffoli, used as a control and uncomputed, share one qubit
+  const int a = 0, b = 1, c = 2, d = 3, t = 4, pool_a = 10, pool_b = 11;
+  auto use_b = gate("CNOT", {pool_b, t});
+  const auto reuse = qristal::reuse_ancillas(
+      circuit({toffoli(a, b, pool_a), gate("CNOT", {pool_a, t}), toffoli(a, b, pool_a),
+               toffoli(c, d, pool_b), use_b, toffoli(c, d, pool_b)}),
+      {pool_a, pool_b});
+  EXPECT_EQ(reuse.ancillas_used, std::vector<int>({pool_a}));
+  EXPECT_TRUE(reuse.dirty_ancillas.empty());
+  EXPECT_EQ(qubits_of(reuse, use_b.id), std::vector<int>({pool_a, t}));
+  EXPECT_EQ(reuse.gates.size(), 4*15 + 2u);
+}
+
+TEST(AncillaLiveness, dirtyAncillas) {
+  // An ancilla left in superposition is never reused, and keeps off the reserved qubits
+  const int pool_a = 10, pool_b = 11, pool_c = 12;
+  auto h = gate("H", {pool_a});
+  auto x = gate("X", {pool_b});
+  const auto reuse = qristal::reuse_ancillas(circuit({h, x, gate("X", {pool_b}), gate("CNOT", {pool_c, 0})}),
+                                             {pool_a, pool_b, pool_c}, {pool_a});
+  EXPECT_EQ(qubits_of(reuse, h.id), std::vector<int>({pool_b}));
+  EXPECT_EQ(qubits_of(reuse, x.id), std::vector<int>({pool_a}));
+  EXPECT_EQ(reuse.dirty_ancillas, std::vector<int>({pool_b}));
+  EXPECT_EQ(reuse.ancillas_used, std::vector<int>({pool_a, pool_b}));
+}
+
+TEST(AncillaLiveness, swapsAndControls) {
+  // A controlled swap through an ancilla, undone, leaves it clean; an ancilla only ever used as
+  // a control stays in |0> throughout
+  const int pool_a = 10, pool_b = 11;
+  const auto reuse = qristal::reuse_ancillas(
+      circuit({gate("Swap", {0, pool_a}), gate("CNOT", {pool_a, 1}), gate("Swap", {0, pool_a}),
+               gate("CZ", {pool_b, 2}), gate("X", {pool_b}), gate("X", {pool_b})}),
+      {pool_a, pool_b});
+  EXPECT_EQ(reuse.ancillas_used, std::vector<int>({pool_a}));
+}
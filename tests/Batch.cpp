@@ -0,0 +1,16 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/batch.hpp"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(Batch, order) {
+  // Grouped by timesteps, then symbols, in input order within a shape
+  const std::vector<std::vector<float>> two_by_two = {{0.5, 0.5}, {0.5, 0.5}};
+  const std::vector<std::vector<float>> two_by_three = {{0.2, 0.3, 0.5}, {0.2, 0.3, 0.5}};
+  const std::vector<std::vector<float>> one_by_two = {{0.5, 0.5}};
+  EXPECT_EQ(qristal::batch_order({two_by_three, two_by_two, one_by_two, two_by_two, two_by_three}),
+            std::vector<std::size_t>({2, 1, 3, 0, 4}));
+  EXPECT_TRUE(qristal::batch_order({}).empty());
+}
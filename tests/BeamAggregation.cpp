@@ -0,0 +1,114 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/beam_aggregation.hpp"
+#include "qristal/decoder/thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <string>
+
+// Measurement counts over random strings with many nulls and repeats
+std::map<std::string, int> random_measurements(int nb_outcomes, int nb_timesteps, int nq_symbol, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> pick(0, 3);
+  std::uniform_int_distribution<int> shots(1, 5);
+  std::map<std::string, int> measurements;
+  while ((int)measurements.size() < nb_outcomes) {
+    std::string bitstring;
+    for (int t = 0; t < nb_timesteps; t++) {
+      int symbol = pick(rng);
+      for (int bit = nq_symbol - 1; bit >= 0; bit--) {
+        bitstring.push_back((symbol >> bit) & 1 ? '1' : '0');
+      }
+    }
+    measurements[bitstring] += shots(rng);
+  }
+  return measurements;
+}
+
+TEST(BeamAggregation, countTable) {
+  qristal::BeamCollapser collapser(8, 2);
+  qristal::BeamCountTable table;
+  std::map<qristal::PackedBeam, int> reference;
+  // Enough distinct beams to force several rounds of growth
+  for (auto &[bitstring, count] : random_measurements(3000, 8, 2, 1)) {
+    auto beam = collapser.collapse(bitstring);
+    table.add(beam, count);
+    reference[beam] += count;
+  }
+  auto sorted = table.sorted();
+  ASSERT_EQ(sorted.size(), reference.size());
+  auto iter = reference.begin();
+  for (auto &[beam, count] : sorted) {
+    EXPECT_TRUE(beam == iter->first);
+    EXPECT_EQ(count, iter->second);
+    iter++;
+  }
+
+  // Merging a table into itself doubles every count
+  qristal::BeamCountTable doubled = table;
+  doubled.merge(table);
+  EXPECT_EQ(doubled.size(), table.size());
+  doubled.for_each([&](const qristal::PackedBeam &beam, int count) { EXPECT_EQ(count, 2 * reference[beam]); });
+}
+
+TEST(BeamAggregation, matchesSerialAggregation) {
+  const int nb_timesteps = 12;
+  const int nq_symbol = 2;
+  auto measurements = random_measurements(40000, nb_timesteps, nq_symbol, 2);
+  qristal::BeamCollapser collapser(nb_timesteps, nq_symbol);
+
+  std::map<qristal::PackedBeam, int> reference;
+  for (auto &[bitstring, count] : measurements) {
+    reference[collapser.collapse(bitstring)] += count;
+  }
+
+  for (int nb_threads : {1, 2, 4, 0}) {
+    auto beams = qristal::aggregate_beams(measurements, collapser, nb_threads);
+    ASSERT_EQ(beams.size(), reference.size());
+    auto iter = reference.begin();
+    for (auto &[beam, count] : beams) {
+      EXPECT_TRUE(beam == iter->first);
+      EXPECT_EQ(count, iter->second);
+      iter++;
+    }
+  }
+}
+
+TEST(BeamAggregation, nestedParallelFor) {
+  // parallel_for called from inside pool tasks must not deadlock
+  qristal::ThreadPool pool(2);
+  std::atomic<int> total{0};
+  pool.parallel_for(8, [&](std::size_t) {
+    pool.parallel_for(8, [&](std::size_t) { total++; });
+  });
+  EXPECT_EQ(total.load(), 64);
+}
+
+TEST(BeamAggregation, leaderConfidence) {
+  EXPECT_DOUBLE_EQ(qristal::leader_confidence(0, 0), 0.5);
+  EXPECT_DOUBLE_EQ(qristal::leader_confidence(50, 50), 0.5);
+  // Three standard deviations: 100 more shots than the runner-up out of 1111
+  EXPECT_NEAR(qristal::leader_confidence(605, 505), 0.99865, 1e-3);
+  EXPECT_GT(qristal::leader_confidence(20, 0), 0.9999);
+}
+
+TEST(BeamAggregation, benchmarkThreads) {
+  const int nb_timesteps = 20;
+  const int nq_symbol = 3;
+  auto measurements = random_measurements(200000, nb_timesteps, nq_symbol, 3);
+  qristal::BeamCollapser collapser(nb_timesteps, nq_symbol);
+  std::cout << " threads        ms\n";
+  for (int nb_threads : {1, 2, 4, 8}) {
+    auto start = std::chrono::steady_clock::now();
+    auto beams = qristal::aggregate_beams(measurements, collapser, nb_threads);
+    auto stop = std::chrono::steady_clock::now();
+    std::cout << std::setw(8) << nb_threads << std::setw(10) << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double, std::milli>(stop - start).count() << "\n";
+    EXPECT_FALSE(beams.empty());
+  }
+}
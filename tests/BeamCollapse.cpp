@@ -0,0 +1,170 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/beam_collapse.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <string>
+
+// The string-based kernel previously used by the simplified decoder, kept as the reference behaviour
+std::string legacy_kernel(const std::string &string_, int nb_timesteps, int nq_symbol, bool is_msb) {
+  std::string no_repeats_;
+  std::string beam_;
+  std::string null_char_(nq_symbol, '0');
+
+  // Contract repeats in string_
+  std::string current_char_ = string_.substr(0, nq_symbol);
+  int current_place_ = 0;
+  int next_place_ = current_place_;
+  std::string next_char_ = current_char_;
+  int no_repeat_length = 0;
+  while (current_place_ < nb_timesteps) {
+    if (is_msb) {
+      no_repeats_ = current_char_ + no_repeats_;
+    } else {
+      no_repeats_ += current_char_;
+    }
+    no_repeat_length++;
+    next_place_++;
+    next_char_ = string_.substr(next_place_ * nq_symbol, nq_symbol);
+    while ((next_char_ == current_char_) and (current_place_ < nb_timesteps)) {
+      current_place_ = next_place_;
+      next_place_++;
+      next_char_ = string_.substr(next_place_ * nq_symbol, nq_symbol);
+    }
+    current_char_ = next_char_;
+    current_place_ = next_place_;
+  }
+
+  // Remove nulls from no_repeats_
+  current_place_ = -1;
+  next_char_ = "";
+  while (current_place_ < no_repeat_length) {
+    beam_ += next_char_;
+    current_place_++;
+    next_char_ = no_repeats_.substr(current_place_ * nq_symbol, nq_symbol);
+    if ((next_char_ == null_char_) & (current_place_ < no_repeat_length)) {
+      current_place_++;
+      next_char_ = no_repeats_.substr(current_place_ * nq_symbol, nq_symbol);
+    }
+  }
+  return beam_;
+}
+
+// Random measured string drawing each symbol from the first nb_symbols symbols, so that repeats and nulls are common
+std::string random_string(std::mt19937 &rng, int nb_timesteps, int nq_symbol, int nb_symbols) {
+  std::uniform_int_distribution<long> pick(0, nb_symbols - 1);
+  std::string bitstring;
+  for (int t = 0; t < nb_timesteps; t++) {
+    long symbol = pick(rng);
+    for (int bit = nq_symbol - 1; bit >= 0; bit--) {
+      bitstring.push_back((symbol >> bit) & 1 ? '1' : '0');
+    }
+  }
+  return bitstring;
+}
+
+TEST(BeamCollapse, matchesLegacyKernel) {
+  // Covers both the specialised widths and the generic fallback (9, 11, 13-15 and above 16)
+  std::mt19937 rng(1234);
+  for (int nq_symbol : {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 16, 17, 24, 32}) {
+    for (int nb_timesteps : {1, 2, 3, 7, 13, 40}) {
+      for (bool is_msb : {false, true}) {
+        qristal::BeamCollapser collapser(nb_timesteps, nq_symbol, is_msb);
+        for (int nb_symbols : {2, 3, nq_symbol < 12 ? 1 << nq_symbol : 4096}) {
+          if (nb_symbols > (1 << std::min(nq_symbol, 30))) continue;
+          for (int trial = 0; trial < 200; trial++) {
+            std::string bitstring = random_string(rng, nb_timesteps, nq_symbol, nb_symbols);
+            EXPECT_EQ(collapser.to_string(collapser.collapse(bitstring)),
+                      legacy_kernel(bitstring, nb_timesteps, nq_symbol, is_msb))
+                << "input " << bitstring << ", msb " << is_msb;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(BeamCollapse, orderingMatchesBitstrings) {
+  // Beams must come out in the same order as the std::map<std::string, int> they replace
+  std::mt19937 rng(42);
+  const int nb_timesteps = 30;
+  const int nq_symbol = 3;
+  qristal::BeamCollapser collapser(nb_timesteps, nq_symbol);
+  std::map<qristal::PackedBeam, int> packed_beams;
+  std::map<std::string, int> string_beams;
+  for (int trial = 0; trial < 2000; trial++) {
+    std::string bitstring = random_string(rng, nb_timesteps, nq_symbol, 3);
+    packed_beams[collapser.collapse(bitstring)]++;
+    string_beams[legacy_kernel(bitstring, nb_timesteps, nq_symbol, false)]++;
+  }
+  ASSERT_EQ(packed_beams.size(), string_beams.size());
+  auto string_iter = string_beams.begin();
+  for (const auto &[beam, count] : packed_beams) {
+    EXPECT_EQ(collapser.to_string(beam), string_iter->first);
+    EXPECT_EQ(count, string_iter->second);
+    string_iter++;
+  }
+}
+
+TEST(BeamCollapse, simple) {
+  // 2 qubits per symbol: a a - a b b -> a a b
+  qristal::BeamCollapser collapser(6, 2);
+  auto beam = collapser.collapse("010100011010");
+  EXPECT_EQ(beam.length, 3);
+  EXPECT_EQ(collapser.to_string(beam), "010110");
+  // Nothing but nulls collapses to the empty beam
+  EXPECT_EQ(collapser.to_string(collapser.collapse("000000000000")), "");
+}
+
+TEST(BeamCollapse, benchmarkAlphabetScaling) {
+  // Per-shot post-processing cost as the alphabet grows from 4 to 65536 symbols.
+  // Measured strings are drawn from a blank-heavy distribution typical of CTC output.
+  const int nb_timesteps = 50;
+  const int nb_shots = 20000;
+  std::cout << " qubits/symbol   alphabet   ns/shot   ns/shot (string kernel)\n";
+  for (int nq_symbol : {2, 4, 5, 8, 10, 12, 16}) {
+    std::mt19937 rng(7);
+    std::bernoulli_distribution blank(0.6);
+    std::uniform_int_distribution<long> symbol(1, (1L << nq_symbol) - 1);
+    std::vector<std::string> shots;
+    for (int shot = 0; shot < nb_shots; shot++) {
+      std::string bitstring;
+      for (int t = 0; t < nb_timesteps; t++) {
+        long s = blank(rng) ? 0 : symbol(rng);
+        for (int bit = nq_symbol - 1; bit >= 0; bit--) {
+          bitstring.push_back((s >> bit) & 1 ? '1' : '0');
+        }
+      }
+      shots.push_back(bitstring);
+    }
+
+    qristal::BeamCollapser collapser(nb_timesteps, nq_symbol);
+    qristal::PackedBeam beam;
+    int total_length = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &bitstring : shots) {
+      collapser.collapse(bitstring, beam);
+      total_length += beam.length;
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double ns_per_shot = std::chrono::duration<double, std::nano>(stop - start).count() / nb_shots;
+
+    std::size_t total_legacy_length = 0;
+    start = std::chrono::steady_clock::now();
+    for (const auto &bitstring : shots) {
+      total_legacy_length += legacy_kernel(bitstring, nb_timesteps, nq_symbol, false).size();
+    }
+    stop = std::chrono::steady_clock::now();
+    double legacy_ns_per_shot = std::chrono::duration<double, std::nano>(stop - start).count() / nb_shots;
+
+    std::cout << std::setw(14) << nq_symbol << std::setw(11) << (1L << nq_symbol)
+              << std::setw(10) << std::fixed << std::setprecision(1) << ns_per_shot
+              << std::setw(26) << legacy_ns_per_shot << "\n";
+    EXPECT_EQ((std::size_t)total_length * nq_symbol, total_legacy_length);
+  }
+}
@@ -0,0 +1,38 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/bounded_executor.hpp"
+
+#include <atomic>
+#include <future>
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(BoundedExecutor, backpressure) {
+  // Two tasks in flight at most: a third is refused while both are held, and taken once one finishes
+  qristal::BoundedExecutor executor(1, 2);
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  std::atomic<int> done{0};
+  auto held = [&] { released.wait(); done++; };
+  EXPECT_TRUE(executor.try_submit(held));
+  EXPECT_TRUE(executor.try_submit(held));
+  EXPECT_EQ(executor.pending(), 2u);
+  EXPECT_FALSE(executor.try_submit(held));
+  release.set_value();
+  executor.submit([&] { done++; });
+  executor.wait_idle();
+  EXPECT_EQ(done, 3);
+  EXPECT_EQ(executor.pending(), 0u);
+}
+
+TEST(BoundedExecutor, order) {
+  // One worker runs tasks in the order submitted, and the destructor finishes them all
+  std::vector<int> order;
+  {
+    qristal::BoundedExecutor executor(1, 3);
+    for (int i = 0; i < 10; i++) {
+      executor.submit([&order, i] { order.push_back(i); });
+    }
+  }
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
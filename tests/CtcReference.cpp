@@ -0,0 +1,167 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/ctc_reference.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+// Beam probabilities by enumerating every string and collapsing it
+std::map<std::vector<int>, double> enumerate_beams(const std::vector<std::vector<float>> &probability_table) {
+  std::map<std::vector<int>, double> beams;
+  const int nb_timesteps = probability_table.size();
+  const int nb_symbols = probability_table[0].size();
+  std::vector<int> symbols(nb_timesteps, 0);
+  while (true) {
+    double probability = 1.0;
+    std::vector<int> beam;
+    int previous = -1;
+    for (int t = 0; t < nb_timesteps; t++) {
+      probability *= probability_table[t][symbols[t]];
+      if (symbols[t] != previous && symbols[t] != 0) {
+        beam.push_back(symbols[t]);
+      }
+      previous = symbols[t];
+    }
+    beams[beam] += probability;
+    int t = 0;
+    while (t < nb_timesteps && ++symbols[t] == nb_symbols) {
+      symbols[t++] = 0;
+    }
+    if (t == nb_timesteps) break;
+  }
+  return beams;
+}
+
+std::vector<std::vector<float>> random_table(std::mt19937 &rng, int nb_timesteps, int nb_symbols) {
+  std::gamma_distribution<float> gamma(0.5);
+  std::vector<std::vector<float>> probability_table(nb_timesteps, std::vector<float>(nb_symbols));
+  for (auto &row : probability_table) {
+    float sum = 0;
+    for (auto &p : row) sum += (p = gamma(rng));
+    for (auto &p : row) p /= sum;
+  }
+  return probability_table;
+}
+
+TEST(CtcReference, forwardMatchesEnumeration) {
+  std::mt19937 rng(5);
+  for (int nb_symbols : {2, 3, 4}) {
+    for (int nb_timesteps : {1, 2, 3, 5, 7}) {
+      auto probability_table = random_table(rng, nb_timesteps, nb_symbols);
+      qristal::CtcReference reference(probability_table);
+      for (const auto &[beam, probability] : enumerate_beams(probability_table)) {
+        EXPECT_NEAR(std::exp(reference.log_probability(beam)), probability, 1e-6);
+      }
+      // Beams longer than the utterance, or needing more timesteps for their repeats, are impossible
+      EXPECT_EQ(reference.log_probability(std::vector<int>(nb_timesteps + 1, 1)), qristal::log_zero);
+      if (nb_timesteps > 1) {
+        EXPECT_EQ(reference.log_probability(std::vector<int>(nb_timesteps, 1)), qristal::log_zero);
+      }
+    }
+  }
+}
+
+TEST(CtcReference, exhaustiveRanking) {
+  // With a beam wide enough to hold every prefix, the top beams are the true ranking
+  std::mt19937 rng(8);
+  for (int trial = 0; trial < 10; trial++) {
+    auto probability_table = random_table(rng, 6, 4);
+    auto exact = enumerate_beams(probability_table);
+    std::vector<std::pair<double, std::vector<int>>> ranking;
+    for (const auto &[beam, probability] : exact) {
+      ranking.emplace_back(probability, beam);
+    }
+    std::sort(ranking.rbegin(), ranking.rend());
+
+    qristal::CtcReference reference(probability_table);
+    const int top_k = 10;
+    auto beams = reference.top_beams(top_k, 100000);
+    ASSERT_EQ((int)beams.size(), top_k);
+    for (int i = 0; i < top_k; i++) {
+      EXPECT_NEAR(std::exp(beams[i].log_probability), ranking[i].first, 1e-6) << "rank " << i;
+      EXPECT_NEAR(std::exp(beams[i].log_probability), exact[beams[i].symbols], 1e-6) << "rank " << i;
+    }
+  }
+}
+
+TEST(CtcReference, simple) {
+  // Same table as the checkSimple algorithm test: beams a and b, with probability 1/4 each
+  std::vector<std::vector<float>> probability_table = {{0.0, 0.5, 0.5, 0.0}, {0.25, 0.25, 0.25, 0.25}};
+  qristal::CtcReference reference(probability_table);
+  auto beams = reference.top_beams(2, 16);
+  ASSERT_EQ(beams.size(), 2u);
+  EXPECT_EQ(beams[0].symbols, std::vector<int>{1});
+  EXPECT_EQ(beams[1].symbols, std::vector<int>{2});
+  EXPECT_NEAR(std::exp(beams[0].log_probability), 0.25, 1e-6);
+  EXPECT_NEAR(std::exp(beams[1].log_probability), 0.25, 1e-6);
+}
+
+TEST(CtcReference, bestPath) {
+  // The argmax string a a - b collapses to a b; its beam probability counts every other string of the beam
+  std::vector<std::vector<float>> probability_table = {
+      {0.2, 0.7, 0.1}, {0.4, 0.6, 0.0}, {0.5, 0.1, 0.4}, {0.3, 0.0, 0.7}};
+  qristal::CtcReference reference(probability_table);
+  const qristal::ScoredBeam beam = reference.best_path();
+  EXPECT_EQ(beam.symbols, std::vector<int>({1, 2}));
+  EXPECT_NEAR(std::exp(beam.log_probability), enumerate_beams(probability_table)[std::vector<int>({1, 2})], 1e-6);
+  EXPECT_LE(beam.log_probability, reference.top_beams(1, 16)[0].log_probability);
+}
+
+TEST(CtcReference, align) {
+  // The alignment is the most probable string of the beam, found by enumerating every string
+  std::mt19937 rng(5);
+  for (int trial = 0; trial < 20; trial++) {
+    const auto probability_table = random_table(rng, 5, 3);
+    qristal::CtcReference reference(probability_table);
+    for (const auto &beam : reference.top_beams(3, 64)) {
+      const std::vector<int> alignment = reference.align(beam.symbols);
+      std::vector<int> collapsed;
+      double probability = 1.0;
+      for (int t = 0; t < 5; t++) {
+        probability *= probability_table[t][alignment[t]];
+        if (alignment[t] != 0 && (t == 0 || alignment[t] != alignment[t - 1])) {
+          collapsed.push_back(alignment[t]);
+        }
+      }
+      EXPECT_EQ(collapsed, beam.symbols);
+
+      double best = 0.0;
+      std::vector<int> string(5, 0);
+      for (int code = 0; code < 243; code++) {
+        double p = 1.0;
+        std::vector<int> string_beam;
+        for (int t = 0, c = code; t < 5; t++, c /= 3) {
+          string[t] = c % 3;
+          p *= probability_table[t][string[t]];
+          if (string[t] != 0 && (t == 0 || string[t] != string[t - 1])) {
+            string_beam.push_back(string[t]);
+          }
+        }
+        if (string_beam == beam.symbols) {
+          best = std::max(best, p);
+        }
+      }
+      EXPECT_NEAR(probability, best, 1e-9);
+    }
+  }
+  EXPECT_THROW(qristal::CtcReference({{0.0, 1.0}, {0.0, 1.0}}).align({1, 1}), std::runtime_error);
+}
+
+TEST(CtcReference, benchmarkBeamSearch) {
+  std::mt19937 rng(9);
+  auto probability_table = random_table(rng, 100, 32);
+  qristal::CtcReference reference(probability_table);
+  auto start = std::chrono::steady_clock::now();
+  auto beams = reference.top_beams(10, 64);
+  auto stop = std::chrono::steady_clock::now();
+  std::cout << "100 timesteps, 32 symbols, beam width 64: "
+            << std::chrono::duration<double, std::milli>(stop - start).count() << " ms\n";
+  ASSERT_EQ(beams.size(), 10u);
+  for (std::size_t i = 1; i < beams.size(); i++) {
+    EXPECT_GE(beams[i - 1].log_probability, beams[i].log_probability);
+  }
+}
@@ -0,0 +1,49 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "xacc.hpp"
+#include "xacc_service.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+TEST(CtcReferenceDecoderAlgorithm, checkSimple) {
+  //Rows represent time step, while columns represent alphabets {"-","a","b","c"}.
+  std::vector<std::vector<float>> probability_table = {{0.0, 0.5, 0.5, 0.0}, {0.25, 0.25, 0.25, 0.25}};
+
+  auto reference_algo = xacc::getAlgorithm(
+    "ctc-reference-decoder", {{"probability_table", probability_table},
+                              {"top_k", 4},
+                              {"shots", 1000}});
+  auto buffer = xacc::qalloc(4);
+  reference_algo->execute(buffer);
+
+  // a and b (1/4 each) are most probable, then the four two-symbol beams ab, ac, ba and bc (1/8 each)
+  auto info = buffer->getInformation();
+  EXPECT_EQ(info.at("nb_beams").as<int>(), 4);
+  EXPECT_EQ(info.at("best_beam").as<std::string>(), "10");
+  EXPECT_EQ(info.at("beam_1").as<std::string>(), "01");
+  EXPECT_NEAR(info.at("beam_probability_0").as<double>(), 0.25, 1e-6);
+  EXPECT_EQ(info.at("beam_count_1").as<int>(), 250);
+  EXPECT_NEAR(info.at("beam_probability_2").as<double>(), 0.125, 1e-6);
+}
+
+TEST(CtcReferenceDecoderAlgorithm, checkFormat) {
+  // Same rigged table and expected beams as check_lsb and check_aer for the simplified decoder
+  std::vector<std::vector<float>> probability_table = {{0.0, 1.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 1.0}};
+
+  auto reference_algo = xacc::getAlgorithm(
+    "ctc-reference-decoder", {{"probability_table", probability_table},
+                              {"is_msb", true}});
+  auto buffer = xacc::qalloc(4);
+  reference_algo->execute(buffer);
+  EXPECT_EQ(buffer->getInformation().at("best_beam").as<std::string>(), "1110");
+
+  reference_algo = xacc::getAlgorithm(
+    "ctc-reference-decoder", {{"probability_table", probability_table},
+                              {"qpu", std::string("aer")}});
+  buffer = xacc::qalloc(4);
+  reference_algo->execute(buffer);
+  EXPECT_EQ(buffer->getInformation().at("best_beam").as<std::string>(), "0111");
+  EXPECT_EQ(buffer->getInformation().at("nb_beams").as<int>(), 1);
+}
@@ -4,6 +4,8 @@
 #include "xacc.hpp"
 #include "xacc_service.hpp"
 #include <gtest/gtest.h>
+#include <map>
+#include <string>
 
 TEST(DecoderKernelCircuit, simple) {
   //////////////////////////////////////
@@ -212,3 +214,80 @@ TEST(DecoderKernelCircuit, simple) {
 
   buffer->print();
 }
+
+TEST(DecoderKernelCircuit, compactionModes) {
+  // The cascade and the network apply the same permutation, so on basis states the
+  // compacted strings and superfluous flags must agree
+  auto gateRegistry = xacc::getService<xacc::IRProvider>("quantum");
+
+  std::vector<int> qubits_string = {0,1};
+  std::vector<int> qubits_metric = {2,3,4,5};
+  std::vector<int> qubits_total_metric_buffer = {6,19,20,21};
+  std::vector<int> qubits_init_null = {7,8};
+  std::vector<int> qubits_init_repeat = {9,10};
+  std::vector<int> qubits_superfluous_flags = {11,12};
+  std::vector<int> qubits_beam_metric = {13,14,15,16,17,18};
+  std::vector<int> qubits_ancilla_pool;
+  for (int i = 25; i <= 60; i++)
+    qubits_ancilla_pool.push_back(i);
+
+  // Qubits set to 1 in each input: "-1" with a null first symbol, "11" with a repeated second symbol,
+  // and "1-" with both symbols flagged
+  std::vector<std::vector<int>> inputs = {{1, 7}, {0, 1, 10}, {0, 7, 10}};
+
+  for (const auto &input : inputs) {
+    std::map<std::string, int> counts[2];
+    const std::string modes[2] = {"cascade", "network"};
+    for (int mode = 0; mode < 2; mode++) {
+      auto state_prep = gateRegistry->createComposite("state_prep");
+      for (int qubit : input) {
+        state_prep->addInstruction(gateRegistry->createInstruction("X", qubit));
+      }
+      auto test_circ = gateRegistry->createComposite("test_circ");
+      test_circ->addInstructions(state_prep->getInstructions());
+
+      auto decoder_kernel = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+          xacc::getService<xacc::Instruction>("DecoderKernel"));
+      xacc::HeterogeneousMap options{
+          {"qubits_string", qubits_string},
+          {"qubits_metric", qubits_metric},
+          {"qubits_total_metric_buffer", qubits_total_metric_buffer},
+          {"qubits_init_null", qubits_init_null},
+          {"qubits_init_repeat", qubits_init_repeat},
+          {"qubits_superfluous_flags", qubits_superfluous_flags},
+          {"qubits_beam_metric", qubits_beam_metric},
+          {"qubits_ancilla_pool", qubits_ancilla_pool},
+          {"metric_state_prep", state_prep},
+          {"compaction", modes[mode]}};
+      EXPECT_TRUE(decoder_kernel->expand(options));
+      test_circ->addInstructions(decoder_kernel->getInstructions());
+
+      for (int qubit : qubits_string) {
+        test_circ->addInstruction(gateRegistry->createInstruction("Measure", qubit));
+      }
+      for (int qubit : qubits_superfluous_flags) {
+        test_circ->addInstruction(gateRegistry->createInstruction("Measure", qubit));
+      }
+      auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 100}});
+      auto buffer = xacc::qalloc(61);
+      acc->execute(buffer, test_circ);
+      counts[mode] = buffer->getMeasurementCounts();
+    }
+    EXPECT_EQ(counts[0], counts[1]);
+  }
+
+  // Unknown modes are rejected
+  auto decoder_kernel = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+      xacc::getService<xacc::Instruction>("DecoderKernel"));
+  auto state_prep = gateRegistry->createComposite("state_prep");
+  EXPECT_FALSE(decoder_kernel->expand({{"qubits_string", qubits_string},
+                                       {"qubits_metric", qubits_metric},
+                                       {"qubits_total_metric_buffer", qubits_total_metric_buffer},
+                                       {"qubits_init_null", qubits_init_null},
+                                       {"qubits_init_repeat", qubits_init_repeat},
+                                       {"qubits_superfluous_flags", qubits_superfluous_flags},
+                                       {"qubits_beam_metric", qubits_beam_metric},
+                                       {"qubits_ancilla_pool", qubits_ancilla_pool},
+                                       {"metric_state_prep", state_prep},
+                                       {"compaction", std::string("bubble")}}));
+}
@@ -0,0 +1,141 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/direct_sampler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <string>
+
+// Measured string a state-vector simulator reports for the given symbols of a Ry-encoded string:
+// qubit i is character i, and each symbol is encoded least significant bit first
+std::string measured_string(const std::vector<int> &symbols, int nq_symbol, bool reversed_bit_order) {
+  std::string bitstring;
+  for (int symbol : symbols) {
+    for (int bit = 0; bit < nq_symbol; bit++) {
+      bitstring.push_back((symbol >> bit) & 1 ? '1' : '0');
+    }
+  }
+  if (reversed_bit_order) {
+    std::reverse(bitstring.begin(), bitstring.end());
+  }
+  return bitstring;
+}
+
+// Exact beam probabilities, by enumerating every measured string
+std::map<std::string, double> exact_beams(const std::vector<std::vector<float>> &probability_table, int nq_symbol,
+                                          bool reversed_bit_order, const qristal::BeamCollapser &collapser) {
+  std::map<std::string, double> beams;
+  const int nb_timesteps = probability_table.size();
+  const int nb_symbols = probability_table[0].size();
+  std::vector<int> symbols(nb_timesteps, 0);
+  while (true) {
+    double probability = 1.0;
+    for (int t = 0; t < nb_timesteps; t++) {
+      probability *= probability_table[t][symbols[t]];
+    }
+    beams[collapser.to_string(collapser.collapse(measured_string(symbols, nq_symbol, reversed_bit_order)))] += probability;
+    int t = 0;
+    while (t < nb_timesteps && ++symbols[t] == nb_symbols) {
+      symbols[t++] = 0;
+    }
+    if (t == nb_timesteps) break;
+  }
+  return beams;
+}
+
+TEST(DirectSampler, aliasTable) {
+  const std::vector<float> row = {0.1, 0.2, 0.0, 0.3, 0.4};
+  qristal::AliasTable table(row);
+  std::mt19937_64 rng(3);
+  const int nb_draws = 1000000;
+  std::vector<int> counts(row.size(), 0);
+  for (int i = 0; i < nb_draws; i++) {
+    counts[table.sample(rng())]++;
+  }
+  for (std::size_t s = 0; s < row.size(); s++) {
+    const double sigma = std::sqrt(nb_draws * row[s] * (1 - row[s]));
+    EXPECT_NEAR(counts[s], nb_draws * row[s], 5 * sigma + 1) << "symbol " << s;
+  }
+  EXPECT_EQ(counts[2], 0);
+
+  EXPECT_THROW(qristal::AliasTable({0.0, 0.0}), std::runtime_error);
+  EXPECT_THROW(qristal::AliasTable({0.5, -0.5}), std::runtime_error);
+}
+
+TEST(DirectSampler, rigged) {
+  // Same rigged table as the check_lsb and check_aer algorithm tests, with the same expected beams
+  std::vector<std::vector<float>> probability_table = {{0.0, 1.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 1.0}};
+  qristal::BeamCollapser collapser(2, 2, true);
+  auto beams = qristal::DirectSampler(probability_table, 2).sample_beams(100, collapser, 1);
+  ASSERT_EQ(beams.size(), 1u);
+  EXPECT_EQ(collapser.to_string(beams[0].first), "1110");
+  EXPECT_EQ(beams[0].second, 100);
+  beams = qristal::DirectSampler(probability_table, 2, true).sample_beams(100, collapser, 1);
+  ASSERT_EQ(beams.size(), 1u);
+  EXPECT_EQ(collapser.to_string(beams[0].first), "0111");
+}
+
+TEST(DirectSampler, matchesExactDistribution) {
+  // Statistics must match those of the measured strings of the Ry-encoded circuit
+  std::vector<std::vector<float>> probability_table = {{0.1, 0.2, 0.3, 0.4, 0.0},
+                                                       {0.5, 0.1, 0.1, 0.2, 0.1},
+                                                       {0.2, 0.2, 0.2, 0.2, 0.2},
+                                                       {0.7, 0.0, 0.1, 0.0, 0.2}};
+  const int nq_symbol = 3;
+  const int shots = 200000;
+  for (bool reversed_bit_order : {false, true}) {
+    for (int nb_threads : {1, 4}) {
+      qristal::BeamCollapser collapser(probability_table.size(), nq_symbol, reversed_bit_order);
+      auto exact = exact_beams(probability_table, nq_symbol, reversed_bit_order, collapser);
+      qristal::DirectSampler sampler(probability_table, nq_symbol, reversed_bit_order);
+      auto beams = sampler.sample_beams(shots, collapser, 11, nb_threads);
+      int total = 0;
+      for (const auto &[beam, count] : beams) {
+        const std::string beam_string = collapser.to_string(beam);
+        ASSERT_TRUE(exact.count(beam_string)) << "impossible beam " << beam_string;
+        const double p = exact[beam_string];
+        EXPECT_NEAR(count, shots * p, 5 * std::sqrt(shots * p * (1 - p)) + 1) << "beam " << beam_string;
+        total += count;
+      }
+      EXPECT_EQ(total, shots);
+    }
+  }
+}
+
+TEST(DirectSampler, seeded) {
+  std::vector<std::vector<float>> probability_table(20, {0.4, 0.2, 0.2, 0.2});
+  qristal::BeamCollapser collapser(20, 2);
+  qristal::DirectSampler sampler(probability_table, 2);
+  auto first = sampler.sample_beams(10000, collapser, 5, 2);
+  EXPECT_EQ(first, sampler.sample_beams(10000, collapser, 5, 2));
+  EXPECT_NE(first, sampler.sample_beams(10000, collapser, 6, 2));
+}
+
+TEST(DirectSampler, benchmarkShots) {
+  // Shots per second for a 50-timestep table, to compare with a state-vector simulation of the circuit
+  const int nb_timesteps = 50;
+  const int shots = 200000;
+  std::cout << " qubits/symbol   shots/s\n";
+  for (int nq_symbol : {2, 5, 8}) {
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> uniform(0.0, 1.0);
+    std::vector<std::vector<float>> probability_table(nb_timesteps, std::vector<float>(1 << nq_symbol));
+    for (auto &row : probability_table) {
+      for (auto &p : row) p = uniform(rng);
+      row[0] += row.size() / 2.0; // blank-heavy, as typical of CTC output
+    }
+    qristal::BeamCollapser collapser(nb_timesteps, nq_symbol);
+    qristal::DirectSampler sampler(probability_table, nq_symbol);
+    auto start = std::chrono::steady_clock::now();
+    auto beams = sampler.sample_beams(shots, collapser, 1);
+    auto stop = std::chrono::steady_clock::now();
+    std::cout << std::setw(14) << nq_symbol << std::setw(10) << std::scientific << std::setprecision(2)
+              << shots / std::chrono::duration<double>(stop - start).count() << "\n";
+    EXPECT_FALSE(beams.empty());
+  }
+}
@@ -0,0 +1,47 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/lru_cache.hpp"
+#include "qristal/decoder/thread_pool.hpp"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <string>
+
+TEST(LruCache, hitsAndEviction) {
+  qristal::LruCache<std::string, int> cache(2);
+  int builds = 0;
+  auto build = [&](int value) { return [&builds, value] { builds++; return value; }; };
+
+  EXPECT_EQ(cache.get_or_create("a", build(1)), std::make_pair(1, false));
+  EXPECT_EQ(cache.get_or_create("b", build(2)), std::make_pair(2, false));
+  EXPECT_EQ(cache.get_or_create("a", build(10)), std::make_pair(1, true));
+  // a was used more recently than b, so b is evicted
+  EXPECT_EQ(cache.get_or_create("c", build(3)), std::make_pair(3, false));
+  EXPECT_EQ(cache.get_or_create("a", build(10)), std::make_pair(1, true));
+  EXPECT_EQ(cache.get_or_create("b", build(20)), std::make_pair(20, false));
+  EXPECT_EQ(builds, 4);
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.hits(), 2u);
+  EXPECT_EQ(cache.misses(), 4u);
+
+  cache.set_capacity(0);
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.get_or_create("a", build(5)), std::make_pair(5, false));
+  EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(LruCache, concurrentMisses) {
+  // Threads missing on the same key all get the one value that was inserted
+  qristal::LruCache<int, int> cache(4);
+  std::atomic<int> builds{0};
+  std::vector<int> values(64);
+  qristal::ThreadPool pool(4);
+  pool.parallel_for(values.size(), [&](std::size_t i) {
+    values[i] = cache.get_or_create(7, [&] { return ++builds; }).first;
+  });
+  for (int value : values) {
+    EXPECT_EQ(value, values[0]);
+  }
+  EXPECT_EQ(cache.size(), 1u);
+  EXPECT_EQ(cache.hits() + cache.misses(), values.size());
+}
@@ -0,0 +1,53 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/ctc_reference.hpp"
+#include "qristal/decoder/probability_table.hpp"
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+TEST(ProbabilityTable, copyOfNestedTable) {
+  const std::vector<std::vector<float>> rows = {{0.1, 0.9, 0.0}, {0.5, 0.25, 0.25}};
+  const qristal::ProbabilityTable table(rows);
+  EXPECT_EQ(table.nb_timesteps(), 2u);
+  EXPECT_EQ(table.nb_symbols(), 3u);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(table.data()) % qristal::ProbabilityTable::alignment, 0u);
+  EXPECT_FLOAT_EQ(table(1, 2), 0.25f);
+  EXPECT_FLOAT_EQ(table[0][1], 0.9f);
+  EXPECT_EQ(table.to_rows(), rows);
+
+  std::size_t t = 0;
+  for (qristal::ProbabilityTable::Row row : table) {
+    EXPECT_EQ(std::vector<float>(row.begin(), row.end()), rows[t++]);
+  }
+  EXPECT_EQ(t, 2u);
+
+  // Copies share the probabilities
+  const qristal::ProbabilityTable copy = table;
+  EXPECT_EQ(copy.data(), table.data());
+
+  EXPECT_THROW(qristal::ProbabilityTable({{0.5, 0.5}, {1.0}}), std::runtime_error);
+  EXPECT_TRUE(qristal::ProbabilityTable().empty());
+}
+
+TEST(ProbabilityTable, viewOfCallerMemory) {
+  // As a network's output tensor, row-major
+  auto tensor = std::make_shared<std::vector<float>>(std::vector<float>{0.2, 0.8, 0.6, 0.4, 0.0, 1.0});
+  const float *data = tensor->data();
+  qristal::ProbabilityTable table = qristal::ProbabilityTable::view(data, 3, 2, tensor);
+  EXPECT_EQ(table.data(), data);
+  EXPECT_EQ(table[1].data(), data + 2);
+
+  // The owner is kept alive by the table
+  tensor.reset();
+  EXPECT_FLOAT_EQ(table(2, 1), 1.0f);
+
+  // Decoded as the nested table it stands for
+  const qristal::CtcReference reference(table);
+  const qristal::CtcReference nested(table.to_rows());
+  EXPECT_EQ(reference.best_path().symbols, nested.best_path().symbols);
+  EXPECT_DOUBLE_EQ(reference.log_probability({1}), nested.log_probability({1}));
+}
@@ -1,10 +1,17 @@
 // Copyright (c) 2022 Quantum Brilliance Pty Ltd
 
+#include "qristal/decoder/resource_plan.hpp"
+#include "qristal/decoder/streaming.hpp"
+#include "qristal/decoder/streaming_decoder.hpp"
+
 #include "Circuit.hpp"
 #include "xacc.hpp"
 #include "xacc_service.hpp"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <iostream>
 #include <numeric>
+#include <string>
 
 TEST(QuantumDecoderCanonicalAlgorithm, checkSimple) {
   //Initial state parameters:
@@ -90,3 +97,432 @@ TEST(QuantumDecoderCanonicalAlgorithm, checkSimple) {
   //buffer->print();
   // EXPECT_GT(BestScore, 0);
 }
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkStatePrepReuse) {
+  // Same register layout as checkSimple
+  int L = 2, S = 1, ml = 3;
+  int ms = std::round(0.49999999 + std::log2(1 + L*(std::pow(2,ml) - 1)));
+  int p = ms*(ms+1)/2;
+  int mb = std::round(0.49999999 + std::log2(1 + std::pow(2, L)*(std::pow(2,ms) - 1)));
+  auto range = [](int begin, int size) {
+    std::vector<int> qubits(size);
+    std::iota(qubits.begin(), qubits.end(), begin);
+    return qubits;
+  };
+  std::vector<int> qubits_metric = range(0, L*ml);
+  std::vector<int> qubits_string = range(L*ml, L*S);
+  std::vector<int> qubits_init_null = range(L*(ml+S), L);
+  std::vector<int> qubits_init_repeat = range(L*(ml+S+1), L);
+  std::vector<int> qubits_superfluous_flags = range(L*(ml+S+2), L);
+  std::vector<int> qubits_total_metric_buffer = range(L*(ml+S+3), ms - ml);
+  std::vector<int> qubits_beam_metric = range(L*(ml+S+3) + ms - ml, mb);
+  std::vector<int> qubits_best_score = range(L*(ml+S+3) + ms - ml + mb, mb);
+  std::vector<int> qubits_ancilla_pool = range(qubits_best_score.back() + 1,
+      std::max({ml+S, ms-ml, 4+5*ms+2*p+ms+S+L*S+L, 4+p+mb+2*ms+L*S+L}));
+  int total_num_qubits = qubits_ancilla_pool.back() + 1;
+
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+  auto decode = [&](std::vector<std::vector<float>> probability_table) {
+    auto quantum_decoder_algo = xacc::getAlgorithm(
+      "quantum-decoder", {{"iteration", L},
+                          {"probability_table", probability_table},
+                          {"qubits_metric", qubits_metric},
+                          {"qubits_string", qubits_string},
+                          {"method", "canonical"},
+                          {"BestScore", 0},
+                          {"N_TRIALS", 1},
+                          {"qubits_total_metric_buffer", qubits_total_metric_buffer},
+                          {"qubits_init_null", qubits_init_null},
+                          {"qubits_init_repeat", qubits_init_repeat},
+                          {"qubits_superfluous_flags", qubits_superfluous_flags},
+                          {"qubits_beam_metric", qubits_beam_metric},
+                          {"qubits_ancilla_pool", qubits_ancilla_pool},
+                          {"qubits_best_score", qubits_best_score},
+                          {"qpu", acc}});
+    auto buffer = xacc::qalloc(total_num_qubits);
+    quantum_decoder_algo->execute(buffer);
+    return buffer->getInformation();
+  };
+
+  // A repeated table reuses the whole circuit, a new table of the same shape the layout template
+  decode({{0.6, 0.4}, {0.3, 0.7}});
+  auto info = decode({{0.6, 0.4}, {0.3, 0.7}});
+  EXPECT_EQ(info.at("state_prep_cache_hit").as<int>(), 1);
+  info = decode({{0.1, 0.9}, {0.5, 0.5}});
+  EXPECT_EQ(info.at("state_prep_cache_hit").as<int>(), 0);
+  EXPECT_EQ(info.at("state_prep_template_hit").as<int>(), 1);
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkStatePrepCache) {
+  // Certain symbols, so that every decode of the table finds the same string: decoded without the cache,
+  // then twice with it, the second decode hits and gives the same result as the uncached one
+  const std::vector<std::vector<float>> probability_table{{0.0, 1.0}, {0.0, 1.0}};
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(qristal::plan_quantum_decoder(2, 2, 3));
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+  auto decode = [&](int state_prep_cache_size) {
+    auto quantum_decoder_algo = xacc::getAlgorithm(
+      "quantum-decoder", {{"probability_table", probability_table},
+                          {"metric_precision", 3},
+                          {"method", "canonical"},
+                          {"N_TRIALS", 1},
+                          {"state_prep_cache_size", state_prep_cache_size},
+                          {"qpu", acc}});
+    auto buffer = xacc::qalloc(layout.num_qubits);
+    quantum_decoder_algo->execute(buffer);
+    return buffer->getInformation();
+  };
+
+  auto uncached = decode(0);
+  EXPECT_EQ(uncached.at("state_prep_cache_hit").as<int>(), 0);
+  auto first = decode(16);
+  EXPECT_EQ(first.at("state_prep_cache_hit").as<int>(), 0);
+  EXPECT_GE(first.at("state_prep_cache_misses").as<int>(), 1);
+  auto cached = decode(16);
+  EXPECT_EQ(cached.at("state_prep_cache_hit").as<int>(), 1);
+  EXPECT_EQ(cached.at("state_prep_cache_misses").as<int>(), first.at("state_prep_cache_misses").as<int>());
+  EXPECT_EQ(cached.at("state_prep_cache_hits").as<int>(), first.at("state_prep_cache_hits").as<int>() + 1);
+  EXPECT_EQ(cached.at("state_prep_template_hit").as<int>(), 1);
+  EXPECT_FALSE(uncached.at("best_string").as<std::string>().empty());
+  EXPECT_EQ(cached.at("best_string").as<std::string>(), uncached.at("best_string").as<std::string>());
+  EXPECT_EQ(cached.at("best_score").as<int>(), uncached.at("best_score").as<int>());
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkBatch) {
+  // Two tables of one shape with different certain beams, a and the empty beam: each utterance of the
+  // batch decodes its own table, as if given alone, and the second reuses the state preparation template
+  const std::vector<std::vector<std::vector<float>>> probability_tables{{{0.0, 1.0}, {0.0, 1.0}},
+                                                                       {{1.0, 0.0}, {1.0, 0.0}}};
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(qristal::plan_quantum_decoder(2, 2, 3));
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+  std::vector<std::string> best_strings;
+  for (const auto &probability_table : probability_tables) {
+    auto quantum_decoder_algo = xacc::getAlgorithm(
+      "quantum-decoder", {{"probability_table", probability_table},
+                          {"metric_precision", 3},
+                          {"N_TRIALS", 1},
+                          {"qpu", acc}});
+    auto buffer = xacc::qalloc(layout.num_qubits);
+    quantum_decoder_algo->execute(buffer);
+    best_strings.push_back(buffer->getInformation().at("best_string").as<std::string>());
+  }
+  EXPECT_NE(best_strings[0], best_strings[1]);
+
+  auto quantum_decoder_algo = xacc::getAlgorithm(
+    "quantum-decoder", {{"probability_tables", probability_tables},
+                        {"metric_precision", 3},
+                        {"N_TRIALS", 1},
+                        {"qpu", acc}});
+  auto buffer = xacc::qalloc(layout.num_qubits);
+  quantum_decoder_algo->execute(buffer);
+  auto info = buffer->getInformation();
+  EXPECT_EQ(info.at("nb_utterances").as<int>(), 2);
+  EXPECT_EQ(info.at("best_strings").as<std::vector<std::string>>(), best_strings);
+  auto children = buffer->getChildren();
+  ASSERT_EQ(children.size(), 2u);
+  EXPECT_EQ(children[1]->getInformation().at("state_prep_template_hit").as<int>(), 1);
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkDryRun) {
+  // A dry run reports the plan without building circuits, even with too small an ancilla pool
+  int L = 2, S = 1, ml = 3, ms = 4, mb = 6;
+  auto range = [](int begin, int size) {
+    std::vector<int> qubits(size);
+    std::iota(qubits.begin(), qubits.end(), begin);
+    return qubits;
+  };
+  auto quantum_decoder_algo = xacc::getAlgorithm(
+    "quantum-decoder", {{"iteration", L},
+                        {"probability_table", std::vector<std::vector<float>>{{0.7, 0.3}, {0.2, 0.8}}},
+                        {"qubits_metric", range(0, L*ml)},
+                        {"qubits_string", range(L*ml, L*S)},
+                        {"method", "canonical"},
+                        {"BestScore", 0},
+                        {"N_TRIALS", 1},
+                        {"qubits_total_metric_buffer", range(L*(ml+S+3), ms - ml)},
+                        {"qubits_init_null", range(L*(ml+S), L)},
+                        {"qubits_init_repeat", range(L*(ml+S+1), L)},
+                        {"qubits_superfluous_flags", range(L*(ml+S+2), L)},
+                        {"qubits_beam_metric", range(L*(ml+S+3) + ms - ml, mb)},
+                        {"qubits_ancilla_pool", range(L*(ml+S+3) + ms - ml + 2*mb, 10)},
+                        {"qubits_best_score", range(L*(ml+S+3) + ms - ml + mb, mb)},
+                        {"dry_run", true}});
+  auto buffer = xacc::qalloc(1);
+  quantum_decoder_algo->execute(buffer);
+  auto info = buffer->getInformation();
+  EXPECT_EQ(info.at("plan_num_qubits").as<int>(), 80);
+  EXPECT_EQ(info.at("plan_num_ancilla").as<int>(), 53);
+  EXPECT_EQ(info.at("plan_ancilla_ok").as<int>(), 0);
+  EXPECT_EQ(info.at("plan_decoder_kernel_ControlledSwap").as<int>(), 2);
+  EXPECT_EQ(info.count("state_prep_cache_hit"), 0u);
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkAutoLayout) {
+  // The automatic layout matches the hand-written one of checkSimple
+  const qristal::ResourcePlan plan = qristal::plan_quantum_decoder(2, 2, 3);
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(plan);
+  EXPECT_EQ(layout.qubits_metric, std::vector<int>({0, 1, 2, 3, 4, 5}));
+  EXPECT_EQ(layout.qubits_string, std::vector<int>({6, 7}));
+  EXPECT_EQ(layout.qubits_superfluous_flags, std::vector<int>({12, 13}));
+  EXPECT_EQ(layout.qubits_total_metric_buffer, std::vector<int>({14}));
+  EXPECT_EQ(layout.qubits_best_score.front(), 21);
+  EXPECT_EQ(layout.qubits_ancilla_pool.size(), 53u);
+  EXPECT_EQ(layout.num_qubits, plan.num_qubits);
+
+  // Only the table and the metric precision are needed to decode
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+  auto quantum_decoder_algo = xacc::getAlgorithm(
+    "quantum-decoder", {{"probability_table", std::vector<std::vector<float>>{{0.7, 0.3}, {0.2, 0.8}}},
+                        {"metric_precision", 3},
+                        {"method", "canonical"},
+                        {"N_TRIALS", 1},
+                        {"qpu", acc}});
+  auto buffer = xacc::qalloc(layout.num_qubits);
+  quantum_decoder_algo->execute(buffer);
+  EXPECT_EQ(buffer->getInformation().count("state_prep_cache_hit"), 1u);
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkAncillaReuse) {
+  // With gate-level ancilla reuse, the decode allocates fewer qubits than the stage-level plan
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(qristal::plan_quantum_decoder(2, 2, 3));
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+  auto quantum_decoder_algo = xacc::getAlgorithm(
+    "quantum-decoder", {{"probability_table", std::vector<std::vector<float>>{{0.7, 0.3}, {0.2, 0.8}}},
+                        {"metric_precision", 3},
+                        {"method", "canonical"},
+                        {"N_TRIALS", 1},
+                        {"reuse_ancilla", true},
+                        {"qpu", acc}});
+  auto buffer = xacc::qalloc(layout.num_qubits);
+  quantum_decoder_algo->execute(buffer);
+  auto info = buffer->getInformation();
+  const int ancilla_pool_used = info.at("ancilla_pool_used").as<int>();
+  EXPECT_LT(ancilla_pool_used, (int)layout.qubits_ancilla_pool.size());
+  EXPECT_LT(info.at("total_num_qubits").as<int>(), layout.num_qubits);
+
+  // Explicit registers with only the pool qubits the remapped circuits use
+  const std::vector<int> qubits_ancilla_pool(layout.qubits_ancilla_pool.begin(),
+                                             layout.qubits_ancilla_pool.begin() + ancilla_pool_used);
+  auto small_pool_algo = xacc::getAlgorithm(
+    "quantum-decoder", {{"iteration", 2},
+                        {"probability_table", std::vector<std::vector<float>>{{0.7, 0.3}, {0.2, 0.8}}},
+                        {"qubits_metric", layout.qubits_metric},
+                        {"qubits_string", layout.qubits_string},
+                        {"method", "canonical"},
+                        {"BestScore", 0},
+                        {"N_TRIALS", 1},
+                        {"qubits_total_metric_buffer", layout.qubits_total_metric_buffer},
+                        {"qubits_init_null", layout.qubits_init_null},
+                        {"qubits_init_repeat", layout.qubits_init_repeat},
+                        {"qubits_superfluous_flags", layout.qubits_superfluous_flags},
+                        {"qubits_beam_metric", layout.qubits_beam_metric},
+                        {"qubits_ancilla_pool", qubits_ancilla_pool},
+                        {"qubits_best_score", layout.qubits_best_score},
+                        {"reuse_ancilla", true},
+                        {"qpu", acc}});
+  auto small_pool_buffer = xacc::qalloc(qubits_ancilla_pool.back() + 1);
+  small_pool_algo->execute(small_pool_buffer);
+  EXPECT_LE(small_pool_buffer->getInformation().at("total_num_qubits").as<int>(), qubits_ancilla_pool.back() + 1);
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkWarmStart) {
+  // The greedy warm start finds beam a, whose strings -a, aa and a- have letter metrics 4 + 5, 2 + 5 and
+  // 2 + 1 on 3 bits, so the search starts from 19
+  const std::vector<std::vector<float>> probability_table{{0.7, 0.3}, {0.2, 0.8}};
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(qristal::plan_quantum_decoder(2, 2, 3));
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+  auto quantum_decoder_algo = xacc::getAlgorithm(
+    "quantum-decoder", {{"probability_table", probability_table},
+                        {"metric_precision", 3},
+                        {"method", "canonical"},
+                        {"N_TRIALS", 1},
+                        {"warm_start", "greedy"},
+                        {"qpu", acc}});
+  auto buffer = xacc::qalloc(layout.num_qubits);
+  quantum_decoder_algo->execute(buffer);
+  EXPECT_EQ(buffer->getInformation().at("warm_start_score").as<int>(), 19);
+
+  auto algo = xacc::getService<xacc::Algorithm>("quantum-decoder");
+  EXPECT_FALSE(algo->initialize({{"probability_table", probability_table},
+                                 {"metric_precision", 3},
+                                 {"warm_start", "oracle"}}));
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkEarlyStop) {
+  // The warm start already reaches the target score, so no exponential search is run
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(qristal::plan_quantum_decoder(2, 2, 3));
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+  auto quantum_decoder_algo = xacc::getAlgorithm(
+    "quantum-decoder", {{"probability_table", std::vector<std::vector<float>>{{0.7, 0.3}, {0.2, 0.8}}},
+                        {"metric_precision", 3},
+                        {"method", "canonical"},
+                        {"N_TRIALS", 4},
+                        {"warm_start", "greedy"},
+                        {"target_score", 10},
+                        {"qpu", acc}});
+  auto buffer = xacc::qalloc(layout.num_qubits);
+  quantum_decoder_algo->execute(buffer);
+  auto info = buffer->getInformation();
+  EXPECT_EQ(info.at("stop_reason").as<std::string>(), "target_score");
+  EXPECT_EQ(info.at("trials_run").as<int>(), 0);
+  EXPECT_EQ(info.at("trials_saved").as<int>(), 4);
+  EXPECT_EQ(info.at("best_score").as<int>(), 19);
+  // The warm start beam a, then a null
+  EXPECT_EQ(info.at("best_string").as<std::string>(), "10");
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkWarmStartOptimal) {
+  // The warm start already finds the only beam, a, whose only string aa the circuit scores 7 + 7. The
+  // search starts from that metric and finds nothing better, and the beam is reported.
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(qristal::plan_quantum_decoder(2, 2, 3));
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+  auto quantum_decoder_algo = xacc::getAlgorithm(
+    "quantum-decoder", {{"probability_table", std::vector<std::vector<float>>{{0.0, 1.0}, {0.0, 1.0}}},
+                        {"metric_precision", 3},
+                        {"method", "canonical"},
+                        {"N_TRIALS", 2},
+                        {"warm_start", "greedy"},
+                        {"qpu", acc}});
+  auto buffer = xacc::qalloc(layout.num_qubits);
+  quantum_decoder_algo->execute(buffer);
+  auto info = buffer->getInformation();
+  const int warm_start_score = info.at("warm_start_score").as<int>();
+  EXPECT_EQ(warm_start_score, 14);
+  EXPECT_GE(info.at("best_score").as<int>(), warm_start_score);
+  EXPECT_EQ(info.at("best_string").as<std::string>().substr(0, 1), "1");
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkWarmStartBound) {
+  // The bound the warm start uses for a beam is at most the beam metric the circuit measures for it
+  const qristal::ResourcePlan plan = qristal::plan_quantum_decoder(2, 2, 3);
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(plan);
+  for (const std::vector<std::vector<float>> &probability_table :
+       {std::vector<std::vector<float>>{{0.0, 1.0}, {0.0, 1.0}}, std::vector<std::vector<float>>{{0.7, 0.3}, {0.2, 0.8}}}) {
+    auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+    auto quantum_decoder_algo = xacc::getAlgorithm(
+      "quantum-decoder", {{"probability_table", probability_table},
+                          {"metric_precision", 3},
+                          {"method", "canonical"},
+                          {"N_TRIALS", 4},
+                          {"qpu", acc}});
+    auto buffer = xacc::qalloc(layout.num_qubits);
+    quantum_decoder_algo->execute(buffer);
+    auto info = buffer->getInformation();
+    const std::string best_string = info.at("best_string").as<std::string>();
+    if (best_string.empty()) {
+      continue;
+    }
+    // One qubit per symbol: the beam is the first best_beam_length bits
+    std::vector<int> beam;
+    for (int i = 0; i < info.at("best_beam_length").as<int>(); i++) {
+      beam.push_back(best_string[i] - '0');
+    }
+    EXPECT_LE(qristal::beam_metric_lower_bound(probability_table, beam, plan), info.at("best_score").as<int>());
+  }
+  EXPECT_EQ(qristal::beam_metric_lower_bound(std::vector<std::vector<float>>{{0.0, 1.0}, {0.0, 1.0}}, {1}, plan), 14);
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkTimestepPruning) {
+  // The leading null is dropped, the repeat merged and the null run merged into one row, so the decode is
+  // planned for 3 timesteps instead of 6
+  const std::vector<std::vector<float>> probability_table{
+      {0.95, 0.05}, {0.1, 0.9}, {0.05, 0.95}, {0.97, 0.03}, {0.98, 0.02}, {0.2, 0.8}};
+  auto quantum_decoder_algo = xacc::getAlgorithm(
+    "quantum-decoder", {{"probability_table", probability_table},
+                        {"metric_precision", 3},
+                        {"N_TRIALS", 1},
+                        {"prune_blank_threshold", 0.9},
+                        {"prune_repeat_threshold", 0.85},
+                        {"dry_run", true}});
+  auto buffer = xacc::qalloc(1);
+  quantum_decoder_algo->execute(buffer);
+  auto info = buffer->getInformation();
+  EXPECT_EQ(info.at("plan_num_qubits").as<int>(), (int)qristal::plan_quantum_decoder(3, 2, 3).num_qubits);
+  EXPECT_EQ(info.at("blanks_pruned").as<int>(), 3);
+  EXPECT_EQ(info.at("repeats_merged").as<int>(), 1);
+  EXPECT_NEAR(info.at("discarded_probability").as<double>(), 1.0 - 0.95*0.95*0.97*0.98, 1e-6);
+
+  // Registers laid out explicitly for the 6 timesteps are cut to the plan of the 3 left
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(qristal::plan_quantum_decoder(6, 2, 3));
+  auto explicit_options = [&](const std::vector<int> &qubits_best_score) {
+    return xacc::HeterogeneousMap{{"probability_table", probability_table},
+                                  {"iteration", 6},
+                                  {"qubits_metric", layout.qubits_metric},
+                                  {"qubits_string", layout.qubits_string},
+                                  {"qubits_init_null", layout.qubits_init_null},
+                                  {"qubits_init_repeat", layout.qubits_init_repeat},
+                                  {"qubits_superfluous_flags", layout.qubits_superfluous_flags},
+                                  {"qubits_total_metric_buffer", layout.qubits_total_metric_buffer},
+                                  {"qubits_beam_metric", layout.qubits_beam_metric},
+                                  {"qubits_best_score", qubits_best_score},
+                                  {"qubits_ancilla_pool", layout.qubits_ancilla_pool},
+                                  {"N_TRIALS", 1},
+                                  {"prune_blank_threshold", 0.9},
+                                  {"prune_repeat_threshold", 0.85},
+                                  {"dry_run", true}};
+  };
+  auto explicit_algo = xacc::getAlgorithm("quantum-decoder", explicit_options(layout.qubits_best_score));
+  auto explicit_buffer = xacc::qalloc(layout.num_qubits);
+  explicit_algo->execute(explicit_buffer);
+  auto explicit_info = explicit_buffer->getInformation();
+  EXPECT_EQ(explicit_info.at("plan_num_qubits").as<int>(), (int)qristal::plan_quantum_decoder(3, 2, 3).num_qubits);
+  EXPECT_EQ(explicit_info.at("plan_registers_ok").as<int>(), 1);
+  EXPECT_EQ(explicit_info.at("plan_iteration").as<int>(), 3);
+
+  // A register too small for the pruned plan is refused
+  const int mb = qristal::plan_quantum_decoder(3, 2, 3).beam_metric_precision;
+  auto algo = xacc::getService<xacc::Algorithm>("quantum-decoder");
+  EXPECT_FALSE(algo->initialize(explicit_options(std::vector<int>(layout.qubits_best_score.begin(),
+                                                                  layout.qubits_best_score.begin() + mb - 1))));
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, checkBeamLength) {
+  // The only string a a b compacts to the register a b a: the beam is its first two symbols, not the
+  // collapse of all three. Streamed as one window, it gives the same beam.
+  const std::vector<std::vector<float>> probability_table{{0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+  const xacc::HeterogeneousMap options{{"metric_precision", 3},
+                                       {"N_TRIALS", 1},
+                                       {"reuse_ancilla", true},
+                                       {"qpu", std::string("sparse-sim")}};
+  xacc::HeterogeneousMap parameters = options;
+  parameters.insert("probability_table", probability_table);
+  auto quantum_decoder_algo = xacc::getAlgorithm("quantum-decoder", parameters);
+  auto buffer = xacc::qalloc(1);
+  quantum_decoder_algo->execute(buffer);
+  auto info = buffer->getInformation();
+  const std::string best_string = info.at("best_string").as<std::string>();
+  ASSERT_EQ(best_string.size(), 6u);
+  EXPECT_EQ(info.at("best_beam_length").as<int>(), 2);
+  EXPECT_EQ(qristal::compacted_beam(best_string, 2, 2), std::vector<int>({1, 2}));
+
+  qristal::StreamingDecoder decoder("quantum-decoder", options, 3, 3);
+  for (const auto &frame : probability_table) {
+    decoder.push(frame);
+  }
+  decoder.finish();
+  EXPECT_EQ(decoder.hypothesis(), std::vector<int>({1, 2}));
+}
+
+TEST(QuantumDecoderCanonicalAlgorithm, benchmarkMethods) {
+  // Oracle queries and search time of each exponential search method, on the table of checkSimple
+  const qristal::DecoderLayout layout = qristal::layout_quantum_decoder(qristal::plan_quantum_decoder(2, 2, 3));
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", 1}});
+  for (const std::string method : {"canonical", "CQAE", "MLQAE"}) {
+    auto quantum_decoder_algo = xacc::getAlgorithm(
+      "quantum-decoder", {{"probability_table", std::vector<std::vector<float>>{{0.7, 0.3}, {0.2, 0.8}}},
+                          {"metric_precision", 3},
+                          {"method", method},
+                          {"N_TRIALS", 1},
+                          {"qpu", acc}});
+    auto buffer = xacc::qalloc(layout.num_qubits);
+    quantum_decoder_algo->execute(buffer);
+    auto info = buffer->getInformation();
+    std::cout << method << ": " << info.at("oracle_queries").as<int>() << " oracle queries, "
+              << info.at("search_seconds").as<double>() << " s\n";
+    EXPECT_EQ(info.at("trials_run").as<int>(), 1);
+  }
+
+  auto algo = xacc::getService<xacc::Algorithm>("quantum-decoder");
+  EXPECT_FALSE(algo->initialize({{"probability_table", std::vector<std::vector<float>>{{0.7, 0.3}, {0.2, 0.8}}},
+                                 {"metric_precision", 3},
+                                 {"method", "bisection"}}));
+}
@@ -0,0 +1,103 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/resource_plan.hpp"
+
+#include "Circuit.hpp"
+#include "xacc.hpp"
+#include "xacc_service.hpp"
+
+#include <cmath>
+#include <gtest/gtest.h>
+#include <map>
+#include <numeric>
+#include <string>
+
+TEST(ResourcePlan, qubitCounts) {
+  // The layout of the QuantumDecoderAlgorithm tests: L = 2, two symbols, ml = 3
+  const qristal::ResourcePlan plan = qristal::plan_quantum_decoder(2, 2, 3);
+  EXPECT_EQ(plan.nq_symbol, 1);
+  EXPECT_EQ(plan.string_metric_precision, 4);
+  EXPECT_EQ(plan.ae_precision, 10);
+  EXPECT_EQ(plan.beam_metric_precision, 6);
+  EXPECT_EQ(plan.num_ancilla, 53);
+  EXPECT_EQ(plan.num_qubits, 80);
+
+  EXPECT_EQ(plan.blocks.at("w_prime").gates.at("WPrime"), 2u);
+  EXPECT_EQ(plan.blocks.at("init_repeat").gates.at("InitRepeatFlag"), 1u);
+  EXPECT_EQ(plan.blocks.at("adder_chain").gates.at("RippleCarryAdder"), 1u);
+  const auto &kernel = plan.blocks.at("decoder_kernel").gates;
+  EXPECT_EQ(kernel.at("X"), 3u);
+  EXPECT_EQ(kernel.at("CX"), 1u);
+  EXPECT_EQ(kernel.at("GeneralisedMCX"), 3u);
+  EXPECT_EQ(kernel.at("ControlledSwap"), 2u);
+  // Every best score bit set, then X, H, CompareGT, H, X on the flag
+  EXPECT_EQ(plan.blocks.at("oracle").gates.at("X"), 8u);
+  EXPECT_EQ(plan.blocks.at("oracle").depth, 5u);
+
+  const qristal::ResourcePlan network = qristal::plan_quantum_decoder(2, 2, 3, 0, "network");
+  EXPECT_EQ(network.num_ancilla, plan.num_ancilla + qristal::compaction_network_ancilla(2));
+  EXPECT_THROW(qristal::plan_quantum_decoder(2, 2, 3, 0, "bubble"), std::runtime_error);
+}
+
+TEST(ResourcePlan, beamMetricScore) {
+  // ms = 4 bits: a certain beam scores 15, and scores are rounded down
+  const qristal::ResourcePlan plan = qristal::plan_quantum_decoder(2, 2, 3);
+  EXPECT_EQ(qristal::beam_metric_score(0.0, plan), 15);
+  EXPECT_EQ(qristal::beam_metric_score(std::log(0.86), plan), 12);
+  EXPECT_EQ(qristal::beam_metric_score(std::log(0.05), plan), 0);
+
+  // Letter metrics on 3 bits: aa is the only string of a certain beam, 7 + 7, and beam a of the other table
+  // sums -a, aa and a- to 9 + 7 + 3. No string of nonzero probability collapses to the null beam of the first.
+  const qristal::ProbabilityTable certain(std::vector<std::vector<float>>{{0.0, 1.0}, {0.0, 1.0}});
+  const qristal::ProbabilityTable uncertain(std::vector<std::vector<float>>{{0.7, 0.3}, {0.2, 0.8}});
+  EXPECT_EQ(qristal::beam_metric_lower_bound(certain, {1}, plan), 14);
+  EXPECT_EQ(qristal::beam_metric_lower_bound(certain, {}, plan), 0);
+  EXPECT_EQ(qristal::beam_metric_lower_bound(uncertain, {1}, plan), 19);
+  EXPECT_EQ(qristal::beam_metric_lower_bound(uncertain, {}, plan), 5);
+}
+
+TEST(ResourcePlan, compactionDepth) {
+  // The cascade grows quadratically in depth, the network polylogarithmically
+  for (int L : {8, 32, 128}) {
+    const auto cascade = qristal::plan_quantum_decoder(L, 4, 2).blocks.at("decoder_kernel");
+    const auto network = qristal::plan_quantum_decoder(L, 4, 2, 0, "network").blocks.at("decoder_kernel");
+    EXPECT_GE(cascade.depth, (std::size_t)L*(L - 1));
+    if (L > 8) {
+      EXPECT_LT(network.depth, cascade.depth/4);
+    }
+  }
+}
+
+TEST(ResourcePlan, matchesDecoderKernel) {
+  // The planned kernel gates are those DecoderKernel adds, apart from the superposition adder
+  auto gateRegistry = xacc::getService<xacc::IRProvider>("quantum");
+  const int L = 3, S = 2;
+  auto range = [](int begin, int size) {
+    std::vector<int> qubits(size);
+    std::iota(qubits.begin(), qubits.end(), begin);
+    return qubits;
+  };
+  for (const std::string compaction : {"cascade", "network"}) {
+    auto decoder_kernel = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+        xacc::getService<xacc::Instruction>("DecoderKernel"));
+    auto state_prep = gateRegistry->createComposite("state_prep");
+    EXPECT_TRUE(decoder_kernel->expand({{"qubits_string", range(0, L*S)},
+                                        {"qubits_metric", range(6, L)},
+                                        {"qubits_total_metric_buffer", range(9, 2)},
+                                        {"qubits_init_null", range(11, L)},
+                                        {"qubits_init_repeat", range(14, L)},
+                                        {"qubits_superfluous_flags", range(17, L)},
+                                        {"qubits_beam_metric", range(20, 4)},
+                                        {"qubits_ancilla_pool", range(24, 40)},
+                                        {"metric_state_prep", state_prep},
+                                        {"compaction", compaction}}));
+
+    std::map<std::string, std::size_t> gates;
+    auto compaction_circuit = std::dynamic_pointer_cast<xacc::CompositeInstruction>(
+        decoder_kernel->getInstruction(0));
+    for (const auto &gate : compaction_circuit->getInstructions()) {
+      gates[gate->name()]++;
+    }
+    EXPECT_EQ(gates, qristal::plan_quantum_decoder(L, 4, 1, S, compaction).blocks.at("decoder_kernel").gates);
+  }
+}
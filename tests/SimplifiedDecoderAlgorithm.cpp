@@ -1,14 +1,25 @@
 // Copyright (c) 2022 Quantum Brilliance Pty Ltd
 
+#include "qristal/decoder/accelerator_pool.hpp"
+#include "qristal/decoder/async_decoder.hpp"
+#include "qristal/decoder/probability_table.hpp"
+#include "qristal/decoder/streaming_decoder.hpp"
+
 #include "Circuit.hpp"
 #include "xacc.hpp"
 #include "xacc_service.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <gtest/gtest.h>
+#include <future>
+#include <map>
 #include <math.h>
 #include <numeric>
+#include <random>
 #include <string>
+#include <thread>
 #include <type_traits>
 
 void check_output_strings(std::vector<std::vector<float>> prob_table, std::vector<int> qubits_string,
@@ -177,3 +188,451 @@ TEST(SimplifiedDecoderAlgorithm, check_lsb) {
   std::cout << max_beam <<  std::endl;
   assert(("best beam should equal c-: " + max_beam, max_beam == "1110"));
 }
+
+TEST(SimplifiedDecoderAlgorithm, check_direct_sample) {
+  //Initial state parameters:
+  std::vector<int> qubits_string ;
+  std::vector<std::string> alphabet = {"-","a","b","c"};
+  int nb_symbols = alphabet.size();
+  int nq_symbol = std::ceil(std::log2(nb_symbols)) ;
+
+  //Rows represent time step, while columns represent alphabets.
+  //Table rigged to yield 'ac' as only beam, drawn without simulating the circuit
+  std::vector<std::vector<float>> probability_table = {{0.0, 1.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 1.0}};
+
+  int nb_timesteps = probability_table.size();
+
+  for (int i = 0; i < nb_timesteps*nq_symbol; i++) {
+      qubits_string.emplace_back(i);
+  }
+
+  auto simplified_decoder_algo = xacc::getAlgorithm(
+    "simplified-decoder", {{"probability_table", probability_table},
+                        {"qubits_string", qubits_string},
+                        {"method", std::string("direct-sample")},
+                        {"shots", 100000},
+                        {"seed", 7},
+                        {"is_msb", true}});
+
+  auto buffer = xacc::qalloc((int)qubits_string.size());
+  simplified_decoder_algo->execute(buffer);
+
+  // Same beam as check_lsb gets from simulating the circuit
+  auto info = buffer->getInformation();
+  EXPECT_EQ(info.at("best_beam").as<std::string>(), "1110");
+  EXPECT_EQ(info.at("nb_beams").as<int>(), 1);
+  EXPECT_EQ(info.at("beam_count_0").as<int>(), 100000);
+
+  // No accelerator is built: 1024 shots by default, as without a qpu to take them from
+  qristal::AcceleratorPool pool("qpp");
+  auto pooled_algo = xacc::getAlgorithm(
+    "simplified-decoder", {{"probability_table", probability_table},
+                           {"qubits_string", qubits_string},
+                           {"method", std::string("direct-sample")},
+                           {"accelerator_pool", &pool},
+                           {"seed", 7},
+                           {"is_msb", true}});
+  auto pooled_buffer = xacc::qalloc((int)qubits_string.size());
+  pooled_algo->execute(pooled_buffer);
+  EXPECT_EQ(pooled_buffer->getInformation().at("beam_count_0").as<int>(), 1024);
+  EXPECT_EQ(pool.size(), 0u);
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_aa) {
+  // Only the string aaa is good: probability 0.42, amplified to 0.73 by one Grover iteration. Beam a then
+  // takes about 91% of the shots rather than 80.5%, so fewer shots tell it apart from the other beams.
+  std::vector<std::vector<float>> probability_table = {{0.25, 0.75}, {0.3, 0.7}, {0.2, 0.8}};
+  std::vector<int> qubits_string = {0, 1, 2};
+  const int shots = 2000;
+  auto acc = xacc::getAccelerator("sparse-sim", {{"shots", shots}});
+
+  std::map<std::string, double> best_beam_share;
+  for (const std::string method : {"ry", "aa"}) {
+    auto simplified_decoder_algo = xacc::getAlgorithm(
+      "simplified-decoder", {{"probability_table", probability_table},
+                             {"qubits_string", qubits_string},
+                             {"method", method},
+                             {"qpu", acc}});
+    auto buffer = xacc::qalloc(2*(int)qubits_string.size() + 1);
+    simplified_decoder_algo->execute(buffer);
+    auto info = buffer->getInformation();
+    const std::string best_beam = info.at("best_beam").as<std::string>();
+    for (int i = 0; i < info.at("nb_beams").as<int>(); i++) {
+      if (info.at("beam_" + std::to_string(i)).as<std::string>() == best_beam) {
+        best_beam_share[method] = info.at("beam_count_" + std::to_string(i)).as<int>() / double(shots);
+      }
+    }
+    if (method == "aa") {
+      EXPECT_EQ(info.at("aa_iterations").as<int>(), 1);
+      EXPECT_NEAR(info.at("aa_success_probability").as<double>(), 0.7318, 1e-3);
+    }
+  }
+  // Shots for the best beam to lead the rest by three standard deviations
+  for (const auto &[method, share] : best_beam_share) {
+    std::cout << method << ": best beam share " << share << ", shots to confidence "
+              << std::ceil(36*share*(1 - share)/std::pow(2*share - 1, 2)) << std::endl;
+  }
+  EXPECT_NEAR(best_beam_share["ry"], 0.805, 0.04);
+  EXPECT_NEAR(best_beam_share["aa"], 0.909, 0.03);
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_sequential) {
+  // With a single possible beam, the first batch already settles the decode
+  std::vector<std::vector<float>> probability_table = {{0.0, 1.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 1.0}};
+  std::vector<int> qubits_string = {0, 1, 2, 3};
+  auto simplified_decoder_algo = xacc::getAlgorithm(
+    "simplified-decoder", {{"probability_table", probability_table},
+                           {"qubits_string", qubits_string},
+                           {"method", std::string("direct-sample")},
+                           {"shots", 100000},
+                           {"shot_batch", 100},
+                           {"seed", 7},
+                           {"is_msb", true}});
+  auto buffer = xacc::qalloc((int)qubits_string.size());
+  simplified_decoder_algo->execute(buffer);
+
+  auto info = buffer->getInformation();
+  EXPECT_EQ(info.at("best_beam").as<std::string>(), "1110");
+  EXPECT_EQ(info.at("shots_used").as<int>(), 100);
+  EXPECT_EQ(info.at("beam_count_0").as<int>(), 100);
+  EXPECT_GT(info.at("confidence").as<double>(), 0.99);
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_batch) {
+  // Tables of different lengths with different beams, ac, b and c: each utterance decodes its own table,
+  // pruned and encoded on its own codebook, as if given alone with the batch seed plus its index
+  const std::vector<std::vector<std::vector<float>>> probability_tables{
+      {{0.0, 1.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 1.0}},
+      {{0.0, 0.0, 1.0, 0.0}, {0.0, 0.0, 1.0, 0.0}, {1.0, 0.0, 0.0, 0.0}},
+      {{0.0, 0.0, 0.0, 1.0}}};
+  std::vector<int> qubits_string(3*2);
+  std::iota(qubits_string.begin(), qubits_string.end(), 0);
+  const xacc::HeterogeneousMap options{{"method", std::string("direct-sample")},
+                                       {"shots", 1000},
+                                       {"prune_blank_threshold", 0.9},
+                                       {"codebook_top_k", 2},
+                                       {"is_msb", true}};
+
+  std::vector<std::string> best_beams;
+  for (std::size_t u = 0; u < probability_tables.size(); u++) {
+    xacc::HeterogeneousMap parameters = options;
+    parameters.insert("probability_table", probability_tables[u]);
+    parameters.insert("qubits_string", std::vector<int>(qubits_string.begin(),
+                                                        qubits_string.begin() + 2*probability_tables[u].size()));
+    parameters.insert("seed", 5 + (int)u);
+    auto simplified_decoder_algo = xacc::getAlgorithm("simplified-decoder", parameters);
+    auto buffer = xacc::qalloc((int)qubits_string.size());
+    simplified_decoder_algo->execute(buffer);
+    best_beams.push_back(buffer->getInformation().at("best_beam").as<std::string>());
+  }
+  EXPECT_NE(best_beams[0], best_beams[1]);
+  EXPECT_NE(best_beams[1], best_beams[2]);
+
+  xacc::HeterogeneousMap parameters = options;
+  parameters.insert("probability_tables", probability_tables);
+  parameters.insert("qubits_string", qubits_string);
+  parameters.insert("seed", 5);
+  auto simplified_decoder_algo = xacc::getAlgorithm("simplified-decoder", parameters);
+  auto buffer = xacc::qalloc((int)qubits_string.size());
+  simplified_decoder_algo->execute(buffer);
+  EXPECT_EQ(buffer->getInformation().at("best_beams").as<std::vector<std::string>>(), best_beams);
+}
+
+TEST(SimplifiedDecoderAlgorithm, benchmark_batch) {
+  // The same utterances decoded one algorithm instance at a time, and as one batch
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  std::vector<std::vector<std::vector<float>>> probability_tables;
+  for (int u = 0; u < 64; u++) {
+    std::vector<std::vector<float>> table(8 + u % 3, std::vector<float>(4));
+    for (auto &row : table) {
+      for (auto &p : row) {
+        p = uniform(rng);
+      }
+      const float total = std::accumulate(row.begin(), row.end(), 0.0f);
+      for (auto &p : row) {
+        p /= total;
+      }
+    }
+    probability_tables.push_back(table);
+  }
+  std::vector<int> qubits_string(10*2);
+  std::iota(qubits_string.begin(), qubits_string.end(), 0);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::string> best_beams;
+  for (std::size_t u = 0; u < probability_tables.size(); u++) {
+    auto simplified_decoder_algo = xacc::getAlgorithm(
+      "simplified-decoder", {{"probability_table", probability_tables[u]},
+                             {"qubits_string", std::vector<int>(qubits_string.begin(),
+                                                                qubits_string.begin() + 2*probability_tables[u].size())},
+                             {"method", std::string("direct-sample")},
+                             {"shots", 20000},
+                             {"num_threads", 1},
+                             {"seed", 11 + (int)u}});
+    auto buffer = xacc::qalloc((int)qubits_string.size());
+    simplified_decoder_algo->execute(buffer);
+    best_beams.push_back(buffer->getInformation().at("best_beam").as<std::string>());
+  }
+  const std::chrono::duration<double> single = std::chrono::steady_clock::now() - start;
+
+  auto simplified_decoder_algo = xacc::getAlgorithm(
+    "simplified-decoder", {{"probability_tables", probability_tables},
+                           {"qubits_string", qubits_string},
+                           {"method", std::string("direct-sample")},
+                           {"shots", 20000},
+                           {"num_threads", 1},
+                           {"seed", 11}});
+  auto buffer = xacc::qalloc((int)qubits_string.size());
+  simplified_decoder_algo->execute(buffer);
+  auto info = buffer->getInformation();
+  std::cout << "64 utterances: " << probability_tables.size()/single.count() << " per second one at a time, "
+            << info.at("utterances_per_second").as<double>() << " per second as a batch\n";
+
+  EXPECT_EQ(info.at("nb_utterances").as<int>(), 64);
+  EXPECT_EQ(info.at("best_beams").as<std::vector<std::string>>(), best_beams);
+  EXPECT_EQ(buffer->getChildren().size(), 64u);
+  // Utterances run across the thread pool, given the cores to do so
+  if (std::thread::hardware_concurrency() >= 4) {
+    EXPECT_GT(info.at("utterances_per_second").as<double>(), probability_tables.size()/single.count());
+  }
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_accelerator_pool_instances) {
+  // Each thread gets its own simulator, the same one on every call, and none is built before it is asked for
+  qristal::AcceleratorPool pool("qpp", {{"shots", 1000}});
+  EXPECT_EQ(pool.size(), 0u);
+  std::vector<xacc::Accelerator *> accelerators(4);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < accelerators.size(); i++) {
+    threads.emplace_back([&, i] {
+      accelerators[i] = pool.get();
+      EXPECT_EQ(pool.get(), accelerators[i]);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  accelerators.push_back(pool.get());
+  for (std::size_t i = 0; i < accelerators.size(); i++) {
+    for (std::size_t j = 0; j < i; j++) {
+      EXPECT_NE(accelerators[i], accelerators[j]);
+    }
+  }
+  EXPECT_EQ(pool.size(), 5u);
+  EXPECT_FALSE(pool.shared());
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_accelerator_pool) {
+  // Circuits of one batch, and of one decoder executed from several threads at once, each simulated on
+  // the executing thread's own accelerator from a shared pool
+  qristal::AcceleratorPool pool("qpp", {{"shots", 1000}});
+  std::vector<std::vector<float>> probability_table = {{0.0, 1.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 1.0}};
+  std::vector<int> qubits_string = {0, 1, 2, 3};
+
+  auto batch_algo = xacc::getAlgorithm(
+    "simplified-decoder", {{"probability_tables", std::vector<std::vector<std::vector<float>>>(16, probability_table)},
+                           {"qubits_string", qubits_string},
+                           {"accelerator_pool", &pool},
+                           {"is_msb", true}});
+  auto buffer = xacc::qalloc((int)qubits_string.size());
+  batch_algo->execute(buffer);
+  EXPECT_EQ(buffer->getInformation().at("best_beams").as<std::vector<std::string>>(),
+            std::vector<std::string>(16, "1110"));
+
+  auto simplified_decoder_algo = xacc::getAlgorithm(
+    "simplified-decoder", {{"probability_table", probability_table},
+                           {"qubits_string", qubits_string},
+                           {"accelerator_pool", &pool},
+                           {"is_msb", true}});
+  std::vector<std::shared_ptr<xacc::AcceleratorBuffer>> buffers(4);
+  std::vector<std::thread> threads;
+  for (auto &thread_buffer : buffers) {
+    thread_buffer = xacc::qalloc((int)qubits_string.size());
+    threads.emplace_back([&, thread_buffer] { simplified_decoder_algo->execute(thread_buffer); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (const auto &thread_buffer : buffers) {
+    EXPECT_EQ(thread_buffer->getInformation().at("best_beam").as<std::string>(), "1110");
+  }
+  EXPECT_GE(pool.size(), 4u);
+}
+
+namespace {
+
+  // A decoder whose execute waits until released, to hold AsyncDecoder workers busy
+  class BlockingDecoder : public xacc::Algorithm {
+    public:
+      std::shared_future<void> release;
+
+      bool initialize(const xacc::HeterogeneousMap &) override { return true; }
+      const std::vector<std::string> requiredParameters() const override { return {}; }
+      void execute(const std::shared_ptr<xacc::AcceleratorBuffer>) const override { release.wait(); }
+      const std::string name() const override { return "blocking-decoder"; }
+      const std::string description() const override { return "Waits until released"; }
+
+      DEFINE_ALGORITHM_CLONE(BlockingDecoder)
+  };
+
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_async) {
+  // Utterances decoded in the background, with at most two in flight, match those decoded in turn
+  std::vector<std::vector<std::vector<float>>> probability_tables = {
+    {{0.0, 1.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 1.0}},
+    {{0.0, 0.0, 1.0, 0.0}, {1.0, 0.0, 0.0, 0.0}},
+    {{0.0, 0.0, 0.0, 1.0}, {0.0, 1.0, 0.0, 0.0}}};
+  std::vector<int> qubits_string = {0, 1, 2, 3};
+
+  qristal::AsyncDecoder async_decoder(2, 2);
+  std::vector<std::future<qristal::AsyncDecoder::Buffer>> results;
+  std::vector<std::string> best_beams;
+  for (const auto &probability_table : probability_tables) {
+    xacc::HeterogeneousMap options = {{"probability_table", probability_table},
+                                      {"qubits_string", qubits_string},
+                                      {"is_msb", true}};
+    auto buffer = xacc::qalloc((int)qubits_string.size());
+    xacc::getAlgorithm("simplified-decoder", options)->execute(buffer);
+    best_beams.push_back(buffer->getInformation().at("best_beam").as<std::string>());
+
+    results.push_back(async_decoder.execute(xacc::getAlgorithm("simplified-decoder", options),
+                                            xacc::qalloc((int)qubits_string.size())));
+  }
+  for (std::size_t u = 0; u < results.size(); u++) {
+    EXPECT_EQ(results[u].get()->getInformation().at("best_beam").as<std::string>(), best_beams[u]);
+  }
+
+  // Callbacks of real decodes, run on the worker thread
+  auto decoder = xacc::getAlgorithm("simplified-decoder", {{"probability_table", probability_tables[0]},
+                                                           {"qubits_string", qubits_string},
+                                                           {"is_msb", true}});
+  std::atomic<int> decoded{0};
+  auto count_decoded = [&](qristal::AsyncDecoder::Buffer buffer, std::exception_ptr error) {
+    if (!error && buffer->getInformation().at("best_beam").as<std::string>() == "1110") {
+      decoded++;
+    }
+  };
+  for (int u = 0; u < 2; u++) {
+    async_decoder.execute(decoder, xacc::qalloc((int)qubits_string.size()), count_decoded);
+  }
+  async_decoder.wait();
+  EXPECT_EQ(decoded, 2);
+
+  // try_execute refuses work once two decodes are in flight, held by decoders that block until released
+  std::promise<void> release;
+  auto blocking_decoder = std::make_shared<BlockingDecoder>();
+  blocking_decoder->release = release.get_future().share();
+  std::atomic<int> finished{0};
+  int accepted = 0;
+  for (int u = 0; u < 8; u++) {
+    accepted += async_decoder.try_execute(blocking_decoder, xacc::qalloc(1),
+                                          [&](qristal::AsyncDecoder::Buffer, std::exception_ptr error) {
+                                            if (!error) {
+                                              finished++;
+                                            }
+                                          });
+  }
+  EXPECT_EQ(accepted, 2);
+  EXPECT_EQ(async_decoder.pending(), 2u);
+  release.set_value();
+  async_decoder.wait();
+  EXPECT_EQ(finished, 2);
+  EXPECT_EQ(async_decoder.pending(), 0u);
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_streaming) {
+  // An utterance longer than any one decode, streamed through windows of 4 timesteps with a hop of 3
+  const std::vector<int> labels = {1, 1, 0, 1, 2, 2, 2, 2, 3, 0, 0, 3, 3, 2, 1, 1, 0, 0, 0, 2};
+  qristal::StreamingDecoder decoder("simplified-decoder", {{"method", std::string("direct-sample")},
+                                                           {"shots", 1000},
+                                                           {"seed", 5},
+                                                           {"is_msb", true}}, 4, 3);
+  int updates = 0;
+  for (int label : labels) {
+    std::vector<float> frame(4, 0.0f);
+    frame[label] = 1.0f;
+    updates += decoder.push(frame);
+  }
+  decoder.finish();
+  EXPECT_EQ(updates, 6);
+  EXPECT_EQ(decoder.hypothesis(), std::vector<int>({1, 1, 2, 3, 3, 2, 1, 2}));
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_streaming_aer) {
+  // The same utterance on aer, whose beams come out in reversed bit order, with is_msb defaulted and given
+  const std::vector<int> labels = {1, 1, 0, 1, 2, 2, 2, 2, 3, 0, 0, 3, 3, 2, 1, 1, 0, 0, 0, 2};
+  auto stream = [&](xacc::HeterogeneousMap options) {
+    options.insert("method", std::string("direct-sample"));
+    options.insert("shots", 1000);
+    options.insert("seed", 5);
+    options.insert("qpu", std::string("aer"));
+    qristal::StreamingDecoder decoder("simplified-decoder", options, 4, 3);
+    for (int label : labels) {
+      std::vector<float> frame(4, 0.0f);
+      frame[label] = 1.0f;
+      decoder.push(frame);
+    }
+    decoder.finish();
+    return decoder.hypothesis();
+  };
+  EXPECT_EQ(stream({}), std::vector<int>({1, 1, 2, 3, 3, 2, 1, 2}));
+  EXPECT_EQ(stream({{"is_msb", false}}), std::vector<int>({1, 1, 2, 3, 3, 2, 1, 2}));
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_codebook) {
+  // 8 symbols, two plausible per timestep: a codebook of two encodes each timestep on 1 qubit instead of 3,
+  // and the beams still come out over the 8 symbols
+  const std::vector<std::vector<float>> probability_table = {
+      {0.0, 0.0, 0.0, 0.0, 0.0, 0.8, 0.2, 0.0},
+      {0.1, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.9},
+      {0.85, 0.15, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}};
+  std::vector<int> qubits_string(9);
+  std::iota(qubits_string.begin(), qubits_string.end(), 0);
+
+  auto decode = [&](const std::string &method, int codebook_top_k) {
+    auto simplified_decoder_algo = xacc::getAlgorithm(
+      "simplified-decoder", {{"probability_table", probability_table},
+                             {"qubits_string", qubits_string},
+                             {"method", method},
+                             {"shots", 2000},
+                             {"seed", 3},
+                             {"codebook_top_k", codebook_top_k}});
+    auto buffer = xacc::qalloc((int)qubits_string.size());
+    simplified_decoder_algo->execute(buffer);
+    return buffer->getInformation();
+  };
+
+  const std::string best_beam = decode("direct-sample", 0).at("best_beam").as<std::string>();
+  for (const std::string method : {"direct-sample", "ry"}) {
+    auto info = decode(method, 2);
+    EXPECT_EQ(info.at("best_beam").as<std::string>(), best_beam);
+    EXPECT_EQ(info.at("nq_code").as<int>(), 1);
+    EXPECT_NEAR(info.at("codebook_discarded_probability").as<double>(), 0.0, 1e-6);
+  }
+}
+
+TEST(SimplifiedDecoderAlgorithm, check_probability_table_view) {
+  // A view over a flat, row-major output decodes as the nested table it stands for
+  const std::vector<float> output = {0.1, 0.6, 0.2, 0.1,
+                                     0.7, 0.1, 0.1, 0.1,
+                                     0.1, 0.1, 0.1, 0.7};
+  const qristal::ProbabilityTable view = qristal::ProbabilityTable::view(output.data(), 3, 4);
+  std::vector<int> qubits_string(6);
+  std::iota(qubits_string.begin(), qubits_string.end(), 0);
+
+  auto decode = [&](const auto &table) {
+    auto simplified_decoder_algo = xacc::getAlgorithm(
+      "simplified-decoder", {{"probability_table", table},
+                             {"qubits_string", qubits_string},
+                             {"method", std::string("direct-sample")},
+                             {"shots", 1000},
+                             {"seed", 5}});
+    auto buffer = xacc::qalloc((int)qubits_string.size());
+    simplified_decoder_algo->execute(buffer);
+    return buffer->getInformation().at("best_beam").as<std::string>();
+  };
+
+  EXPECT_EQ(decode(view), decode(view.to_rows()));
+}
@@ -0,0 +1,87 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/ctc_reference.hpp"
+#include "qristal/decoder/streaming.hpp"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+  // One-hot frame
+  std::vector<float> frame(int symbol, int nb_symbols = 4) {
+    std::vector<float> row(nb_symbols, 0.0f);
+    row[symbol] = 1.0f;
+    return row;
+  }
+
+  // Stream frames through a stitcher, decoding every window by its best path
+  std::vector<int> stream(const std::vector<std::vector<float>> &frames, int window_size, int hop,
+                          std::vector<std::vector<int>> *hypotheses = nullptr) {
+    qristal::WindowStitcher stitcher(window_size, hop);
+    for (const auto &row : frames) {
+      if (stitcher.push(row)) {
+        stitcher.commit(qristal::CtcReference(stitcher.window()).best_path().symbols);
+        EXPECT_LE(stitcher.window().size(), (std::size_t)window_size);
+        if (hypotheses) hypotheses->push_back(stitcher.hypothesis());
+      }
+    }
+    if (stitcher.finish()) {
+      stitcher.commit(qristal::CtcReference(stitcher.window()).best_path().symbols);
+    }
+    EXPECT_EQ(stitcher.frames_committed(), stitcher.frames_seen());
+    EXPECT_EQ(stitcher.hypothesis(), stitcher.committed());
+    return stitcher.committed();
+  }
+
+}
+
+TEST(Streaming, seams) {
+  // A symbol held across a seam is emitted once, a symbol repeated with a null between kept twice
+  const std::vector<int> labels = {1, 1, 1, 1, 1, 0, 1, 2, 2, 2, 2, 3, 0, 0, 3, 3, 2};
+  std::vector<std::vector<float>> frames;
+  for (int label : labels) frames.push_back(frame(label));
+  const std::vector<int> expected = {1, 1, 2, 3, 3, 2};
+  for (int window_size : {3, 4, 6, 8}) {
+    for (int hop = 1; hop <= window_size; hop++) {
+      EXPECT_EQ(stream(frames, window_size, hop), expected) << window_size << " " << hop;
+    }
+  }
+}
+
+TEST(Streaming, matchesWholeUtterance) {
+  // With a window's best path, stitching gives the best path of the whole utterance, and every partial
+  // hypothesis is a prefix of it up to its tentative tail
+  std::mt19937 rng(9);
+  std::gamma_distribution<float> gamma(0.3);
+  std::vector<std::vector<float>> frames(60, std::vector<float>(5));
+  for (auto &row : frames) {
+    float sum = 0;
+    for (auto &p : row) sum += (p = gamma(rng));
+    for (auto &p : row) p /= sum;
+  }
+  std::vector<std::vector<int>> hypotheses;
+  const std::vector<int> beam = stream(frames, 12, 8, &hypotheses);
+  EXPECT_EQ(beam, qristal::CtcReference(frames).best_path().symbols);
+  EXPECT_EQ(hypotheses.size(), 7u);
+}
+
+TEST(Streaming, beamSymbols) {
+  EXPECT_EQ(qristal::beam_symbols("1011", 2, false), std::vector<int>({1, 3}));
+  EXPECT_EQ(qristal::beam_symbols("1110", 2, true), std::vector<int>({1, 3}));
+  // As the simplified decoder reports the beam a c on aer: bits most significant first, time order by default
+  EXPECT_EQ(qristal::beam_symbols("0111", 2, true, true), std::vector<int>({1, 3}));
+  EXPECT_EQ(qristal::beam_symbols("1101", 2, false, true), std::vector<int>({1, 3}));
+  EXPECT_TRUE(qristal::beam_symbols("", 2, false).empty());
+  EXPECT_THROW(qristal::beam_symbols("101", 2, false), std::runtime_error);
+}
+
+TEST(Streaming, compactedBeam) {
+  // a a b compacts to the beam a b, with the last a left over: 1 2 1
+  EXPECT_EQ(qristal::compacted_beam("100110", 2, 2), std::vector<int>({1, 2}));
+  // a - a compacts to the beam a a, with the null left over: 1 1 0
+  EXPECT_EQ(qristal::compacted_beam("101000", 2, 2), std::vector<int>({1, 1}));
+  EXPECT_TRUE(qristal::compacted_beam("101000", 0, 2).empty());
+  EXPECT_THROW(qristal::compacted_beam("1010", 3, 2), std::runtime_error);
+}
@@ -0,0 +1,84 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/beam_aggregation.hpp"
+#include "qristal/decoder/direct_sampler.hpp"
+#include "qristal/decoder/symbol_codebook.hpp"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+  // Measured string of the given symbols (or codes), least significant bit first, as a simulator reports it
+  std::string measured(const std::vector<int> &symbols, int nq_symbol, bool reversed_bit_order) {
+    std::string bitstring;
+    for (int symbol : symbols) {
+      for (int bit = 0; bit < nq_symbol; bit++) {
+        bitstring.push_back((symbol >> bit) & 1 ? '1' : '0');
+      }
+    }
+    if (reversed_bit_order) {
+      std::reverse(bitstring.begin(), bitstring.end());
+    }
+    return bitstring;
+  }
+
+}
+
+TEST(SymbolCodebook, build) {
+  // 8 symbols, at most 2 kept per timestep, fewer where they already hold 90% of the probability
+  const std::vector<std::vector<float>> probability_table = {
+      {0.05, 0.6, 0.3, 0.05, 0.0, 0.0, 0.0, 0.0},
+      {0.95, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.05},
+      {0.1, 0.1, 0.1, 0.1, 0.1, 0.1, 0.2, 0.2}};
+  const qristal::SymbolCodebook codebook(probability_table, 2, 0.9);
+  EXPECT_EQ(codebook.nq_code(), 1);
+  EXPECT_EQ(codebook.symbols(), std::vector<std::vector<int>>({{1, 2}, {0, 0}, {6, 7}}));
+  EXPECT_NEAR(codebook.code_table()[0][0], 0.6/0.9, 1e-6);
+  EXPECT_NEAR(codebook.code_table()[0][1], 0.3/0.9, 1e-6);
+  EXPECT_EQ(codebook.code_table()[1], std::vector<float>({1.0, 0.0}));
+  EXPECT_NEAR(codebook.discarded_probability(), 1.0 - 0.9*0.95*0.4, 1e-6);
+
+  // No limits keep every symbol
+  const qristal::SymbolCodebook full(probability_table, 0, 1.0);
+  EXPECT_EQ(full.nq_code(), 3);
+  EXPECT_NEAR(full.discarded_probability(), 0.0, 1e-6);
+}
+
+TEST(SymbolCodebook, translate) {
+  const std::vector<std::vector<float>> probability_table = {
+      {0.05, 0.6, 0.3, 0.05, 0.0, 0.0, 0.0, 0.0},
+      {0.1, 0.1, 0.1, 0.1, 0.1, 0.1, 0.2, 0.2}};
+  const qristal::SymbolCodebook codebook(probability_table, 2, 1.0);
+  for (bool reversed : {false, true}) {
+    EXPECT_EQ(codebook.translate(measured({1, 0}, 1, reversed), 3, reversed), measured({2, 6}, 3, reversed));
+    EXPECT_EQ(codebook.translate(std::map<std::string, int>{{measured({0, 1}, 1, reversed), 3},
+                                                            {measured({1, 1}, 1, reversed), 4}}, 4, reversed),
+              (std::map<std::string, int>{{measured({1, 7}, 4, reversed), 3}, {measured({2, 7}, 4, reversed), 4}}));
+  }
+}
+
+TEST(SymbolCodebook, directSampler) {
+  // Codes drawn from the code table come out as beams over the symbols, as the translated measurements do
+  const std::vector<std::vector<float>> probability_table = {
+      {0.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0},
+      {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0},
+      {1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0}};
+  const qristal::SymbolCodebook codebook(probability_table, 1, 1.0);
+  for (bool reversed : {false, true}) {
+    const qristal::BeamCollapser collapser(3, 3, reversed);
+    const qristal::DirectSampler sampler(codebook.code_table(), 3, reversed, codebook.symbols());
+    const auto beams = sampler.sample_beams(100, collapser, 1);
+    ASSERT_EQ(beams.size(), 1u);
+    EXPECT_EQ(beams[0].second, 100);
+    const auto measured_beams = qristal::aggregate_beams(
+        codebook.translate(std::map<std::string, int>{{measured({0, 0, 0}, 1, reversed), 100}}, 3, reversed),
+        collapser);
+    EXPECT_EQ(collapser.to_string(beams[0].first), collapser.to_string(measured_beams[0].first));
+    EXPECT_EQ(collapser.to_string(beams[0].first),
+              collapser.to_string(collapser.collapse(measured({5, 7, 0}, 3, reversed))));
+  }
+}
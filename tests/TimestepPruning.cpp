@@ -0,0 +1,77 @@
+// Copyright (c) Quantum Brilliance Pty Ltd
+
+#include "qristal/decoder/timestep_pruning.hpp"
+
+#include <cmath>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+  std::vector<int> collapse(const std::vector<int> &string) {
+    std::vector<int> beam;
+    int previous = 0;
+    for (int symbol : string) {
+      if (symbol != 0 && symbol != previous) beam.push_back(symbol);
+      previous = symbol;
+    }
+    return beam;
+  }
+
+}
+
+TEST(TimestepPruning, blanksAndRepeats) {
+  const std::vector<std::vector<float>> probability_table = {
+      {0.95, 0.05, 0.0},  // leading null, dropped
+      {0.1, 0.9, 0.0},
+      {0.05, 0.95, 0.0},  // repeat, merged
+      {0.99, 0.0, 0.01},  // run of nulls, merged
+      {0.98, 0.01, 0.01},
+      {0.1, 0.9, 0.0},    // not merged across the null row
+      {0.97, 0.02, 0.01}, // lone null, kept
+      {0.3, 0.3, 0.4},
+      {0.95, 0.05, 0.0}}; // trailing null, dropped
+  const qristal::PrunedTable pruned = qristal::prune_timesteps(probability_table, 0.9, 0.85);
+  ASSERT_EQ(pruned.probability_table.size(), 5u);
+  EXPECT_EQ(pruned.first_timestep, std::vector<int>({1, 3, 5, 6, 7}));
+  EXPECT_EQ(pruned.last_timestep, std::vector<int>({2, 4, 5, 6, 7}));
+  EXPECT_EQ(pruned.probability_table[1], std::vector<float>({1.0, 0.0, 0.0}));
+  EXPECT_EQ(pruned.nb_blanks_pruned, 4);
+  EXPECT_EQ(pruned.nb_repeats_merged, 1);
+  EXPECT_NEAR(pruned.discarded_probability, 1.0 - 0.95*0.95*0.99*0.98*0.95, 1e-6);
+
+  // Nothing is decided at a threshold of 1
+  const qristal::PrunedTable unpruned = qristal::prune_timesteps(probability_table, 1.0, 1.0);
+  EXPECT_EQ(unpruned.probability_table, probability_table);
+  EXPECT_EQ(unpruned.discarded_probability, 0.0);
+}
+
+TEST(TimestepPruning, beamsMapBack) {
+  // Every string of a pruned table unprunes to a string of the same beam
+  std::mt19937 rng(2);
+  std::gamma_distribution<float> gamma(0.2);
+  for (int trial = 0; trial < 50; trial++) {
+    std::vector<std::vector<float>> probability_table(12, std::vector<float>(3));
+    for (auto &row : probability_table) {
+      float sum = 0;
+      for (auto &p : row) sum += (p = gamma(rng));
+      for (auto &p : row) p /= sum;
+    }
+    const qristal::PrunedTable pruned = qristal::prune_timesteps(probability_table, 0.8, 0.8);
+    EXPECT_EQ(pruned.nb_timesteps, 12);
+    EXPECT_EQ(pruned.probability_table.size() + pruned.nb_blanks_pruned + pruned.nb_repeats_merged,
+              12u + std::count_if(pruned.probability_table.begin(), pruned.probability_table.end(),
+                                  [](const auto &row) { return row[0] == 1.0f; }));
+    std::uniform_int_distribution<int> symbol(0, 2);
+    for (int k = 0; k < 20; k++) {
+      std::vector<int> string;
+      for (const auto &row : pruned.probability_table) {
+        string.push_back(row[0] == 1.0f ? 0 : symbol(rng));
+      }
+      const std::vector<int> original = qristal::unprune_string(pruned, string);
+      ASSERT_EQ(original.size(), 12u);
+      EXPECT_EQ(collapse(original), collapse(string));
+    }
+  }
+}